@@ -1,11 +1,7 @@
 #ifndef __ASTNODES_H__
 #define __ASTNODES_H__
 
-#include <iostream>
 #include <vector>
-#include <stack>
-
-#include <memory>
 #include <string>
 
 #include "global.h"
@@ -15,71 +11,39 @@ class NStatement;
 class NExpression;
 class NVariableDeclaration;
 
-typedef std::vector<std::shared_ptr<NStatement>> StatementList;
-typedef std::vector<std::shared_ptr<NExpression>> ExpressionList;
+typedef std::vector<NStatement *> StatementList;
+typedef std::vector<NExpression *> ExpressionList;
 
 // 所有节点的基类
 class Node
 {
-protected:
-    std::string funcNamePrefix = "__func_";
-    std::string indent = "\t";
-    std::string labelPrefix = "_L_";
-    static int labelNo;
-    static IdentifierTable identifierTable; // 标识符表
-    static std::stack<int> labelStack;      // 标签栈，用于continue和break
-
-    static ssize_t getEbpOffset(const std::string &name)
-    {
-        return identifierTable.get(identifierTable.find(name)).offset;
-    }
-
 public:
     Node() {}
     virtual ~Node() {}
-    virtual std::string getTypeName() const = 0;
-    virtual void genAsmCode(std::ostream &out, std::string &prefix) const {};
+    virtual const char *getTypeName() const = 0;
 };
 
-// 类型
-class NType : public Node
+// 表达式，整体有值
+class NExpression : public Node
 {
 public:
-    CType type;
-
-    NType() : type(CType::INT) {}
-
-    NType(CType type) : type(type) {}
+    NExpression() {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
-        return "NType";
+        return "NExpression";
     }
-};
-
-// 运算符
-class NOperator : public Node
-{
-public:
-    COperator op;
 
-    NOperator(COperator op) : op(op) {}
-
-    std::string getTypeName() const override
+    // 表达式中是否含有赋值，含有时先求值的操作数不能直接引用变量
+    virtual bool hasAssignment() const
     {
-        return "NOperator";
+        return false;
     }
-};
-
-// 表达式，整体有值，最后一条语句都是“push eax”
-class NExpression : public Node
-{
-public:
-    NExpression() {}
 
-    std::string getTypeName() const override
+    // 表达式求值是否有副作用（赋值或函数调用）
+    virtual bool hasSideEffect() const
     {
-        return "NExpression";
+        return false;
     }
 };
 
@@ -89,7 +53,7 @@ class NStatement : public Node
 public:
     NStatement() {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NStatement";
     }
@@ -105,77 +69,57 @@ public:
 
     NInteger(int value) : value(value) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NInteger";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        out << prefix << "push " << value << std::endl;
-    }
 };
 
 // 标识符
 class NIdentifier : public NExpression
 {
 public:
-    const std::string name;
+    const Symbol *const symbol; // 驻留后的名字，同名标识符的symbol相同
+    int line = 0;  // 所在的行号，用于报错
+    size_t offset = 0; // 在源文件映射中的偏移
+    int slot = -1; // 名字解析得到的变量编号，编号为i的变量存放在虚拟寄存器i中
 
-    NIdentifier(const std::string &name) : name(name) {}
+    NIdentifier(const Symbol *symbol) : symbol(symbol) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NIdentifier";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        if (getEbpOffset(name) > 0)
-            out << prefix << "mov eax, DWORD PTR [ebp+" << getEbpOffset(name) << "]" << std::endl;
-        else
-            out << prefix << "mov eax, DWORD PTR [ebp-" << -getEbpOffset(name) << "]" << std::endl;
-        out << prefix << "push eax" << std::endl;
-    }
 };
 
 // 函数调用表达式
 class NMethodCall : public NExpression
 {
 public:
-    const std::shared_ptr<NIdentifier> id;
-    std::shared_ptr<ExpressionList> arguments = std::make_shared<ExpressionList>();
+    NIdentifier *const id;
+    ExpressionList *arguments;
 
-    NMethodCall(const std::shared_ptr<NIdentifier> id, std::shared_ptr<ExpressionList> arguments)
+    NMethodCall(NIdentifier *id, ExpressionList *arguments)
         : id(id), arguments(arguments) {}
 
-    NMethodCall(const std::shared_ptr<NIdentifier> id)
-        : id(id) {}
-
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NMethodCall";
     }
 
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
+    bool hasAssignment() const override
     {
-        // 函数参数倒着入栈
-        for (auto it = arguments->rbegin(); it != arguments->rend(); it++)
-        {
-            (*it)->genAsmCode(out, prefix);
-        }
-        if (id->name == "println_int")
+        for (auto it = arguments->begin(); it != arguments->end(); it++)
         {
-            out << prefix << "push offset format_str" << std::endl;
-            out << prefix << "call printf" << std::endl;
-            out << prefix << "add esp, 8" << std::endl;
+            if ((*it)->hasAssignment())
+                return true;
         }
-        else
-        {
-            out << prefix << "call " << funcNamePrefix << id->name << std::endl;
-            out << prefix << "add esp, " << arguments->size() * 4 << std::endl;
-        }
-        out << prefix << "push eax" << std::endl;
+        return false;
+    }
+
+    bool hasSideEffect() const override
+    {
+        return true;
     }
 };
 
@@ -183,107 +127,26 @@ public:
 class NBinaryOperatorExpression : public NExpression
 {
 public:
-    std::shared_ptr<NOperator> op;
-    std::shared_ptr<NExpression> left;
-    std::shared_ptr<NExpression> right;
+    COperator op;
+    NExpression *left;
+    NExpression *right;
 
-    NBinaryOperatorExpression(std::shared_ptr<NExpression> left, std::shared_ptr<NOperator> op, std::shared_ptr<NExpression> right)
-        : left(left), right(right), op(op) {}
+    NBinaryOperatorExpression(NExpression *left, COperator op, NExpression *right)
+        : op(op), left(left), right(right) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NBinaryOperator";
     }
 
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
+    bool hasAssignment() const override
     {
-        left->genAsmCode(out, prefix);
-        right->genAsmCode(out, prefix);
-        out << prefix << "pop ebx" << std::endl;
-        out << prefix << "pop eax" << std::endl;
+        return left->hasAssignment() || right->hasAssignment();
+    }
 
-        switch (op->op)
-        {
-        case COperator::PLUS:
-            out << prefix << "add eax, ebx" << std::endl;
-            break;
-        case COperator::MINUS:
-            out << prefix << "sub eax, ebx" << std::endl;
-            break;
-        case COperator::MUL:
-            out << prefix << "imul eax, ebx" << std::endl;
-            break;
-        case COperator::DIV:
-            out << prefix << "cdq" << std::endl;
-            out << prefix << "idiv ebx" << std::endl;
-            break;
-        case COperator::MOD:
-            out << prefix << "cdq" << std::endl;
-            out << prefix << "idiv ebx" << std::endl;
-            out << prefix << "mov eax, edx" << std::endl;
-            break;
-        case COperator::CEQ:
-            out << prefix << "cmp eax, ebx" << std::endl;
-            out << prefix << "sete al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            break;
-        case COperator::CNE:
-            out << prefix << "cmp eax, ebx" << std::endl;
-            out << prefix << "setne al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            break;
-        case COperator::CGE:
-            out << prefix << "cmp eax, ebx" << std::endl;
-            out << prefix << "setge al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            break;
-        case COperator::CGT:
-            out << prefix << "cmp eax, ebx" << std::endl;
-            out << prefix << "setg al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            break;
-        case COperator::CLT:
-            out << prefix << "cmp eax, ebx" << std::endl;
-            out << prefix << "setl al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            break;
-        case COperator::CLE:
-            out << prefix << "cmp eax, ebx" << std::endl;
-            out << prefix << "setle al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            break;
-        case COperator::BITAND:
-            out << prefix << "and eax, ebx" << std::endl;
-            break;
-        case COperator::BITOR:
-            out << prefix << "or eax, ebx" << std::endl;
-            break;
-        case COperator::BITXOR:
-            out << prefix << "xor eax, ebx" << std::endl;
-            break;
-        case COperator::AND:
-            out << prefix << "test eax, eax" << std::endl;
-            out << prefix << "setne al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            out << prefix << "test ebx, ebx" << std::endl;
-            out << prefix << "setne bl" << std::endl;
-            out << prefix << "movzx ebx, bl" << std::endl;
-            out << prefix << "and eax, ebx" << std::endl;
-            break;
-        case COperator::OR:
-            out << prefix << "test eax, eax" << std::endl;
-            out << prefix << "setne al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            out << prefix << "test ebx, ebx" << std::endl;
-            out << prefix << "setne bl" << std::endl;
-            out << prefix << "movzx ebx, bl" << std::endl;
-            out << prefix << "or eax, ebx" << std::endl;
-            break;
-        default:
-            std::cerr << "[ERROR] Unknown operator: " << op->op << std::endl;
-            break;
-        }
-        out << prefix << "push eax" << std::endl;
+    bool hasSideEffect() const override
+    {
+        return left->hasSideEffect() || right->hasSideEffect();
     }
 };
 
@@ -291,39 +154,25 @@ public:
 class NUnaryOperatorExpression : public NExpression
 {
 public:
-    std::shared_ptr<NOperator> op;
-    std::shared_ptr<NExpression> operand;
+    COperator op;
+    NExpression *operand;
 
-    NUnaryOperatorExpression(std::shared_ptr<NExpression> operand, std::shared_ptr<NOperator> op)
-        : operand(operand), op(op) {}
+    NUnaryOperatorExpression(NExpression *operand, COperator op)
+        : op(op), operand(operand) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NUnaryOperator";
     }
 
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
+    bool hasAssignment() const override
     {
-        operand->genAsmCode(out, prefix);
-        out << prefix << "pop eax" << std::endl;
-        switch (op->op)
-        {
-        case COperator::NEG:
-            out << prefix << "neg eax" << std::endl;
-            break;
-        case COperator::BITNOT:
-            out << prefix << "not eax" << std::endl;
-            break;
-        case COperator::NOT:
-            out << prefix << "cmp eax, 0" << std::endl;
-            out << prefix << "sete al" << std::endl;
-            out << prefix << "movzx eax, al" << std::endl;
-            break;
-        default:
-            std::cerr << "[ERROR] Unknown operator: " << op->op << std::endl;
-            break;
-        }
-        out << prefix << "push eax" << std::endl;
+        return operand->hasAssignment();
+    }
+
+    bool hasSideEffect() const override
+    {
+        return operand->hasSideEffect();
     }
 };
 
@@ -331,26 +180,25 @@ public:
 class NAssignment : public NExpression
 {
 public:
-    std::shared_ptr<NIdentifier> left;
-    std::shared_ptr<NExpression> right;
+    NIdentifier *left;
+    NExpression *right;
 
-    NAssignment(std::shared_ptr<NIdentifier> left, std::shared_ptr<NExpression> right)
+    NAssignment(NIdentifier *left, NExpression *right)
         : left(left), right(right) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NAssignment";
     }
 
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
+    bool hasAssignment() const override
+    {
+        return true;
+    }
+
+    bool hasSideEffect() const override
     {
-        right->genAsmCode(out, prefix);
-        out << prefix << "pop eax" << std::endl;
-        if (getEbpOffset(left->name) > 0)
-            out << prefix << "mov DWORD PTR [ebp+" << getEbpOffset(left->name) << "], eax" << std::endl;
-        else
-            out << prefix << "mov DWORD PTR [ebp-" << -getEbpOffset(left->name) << "], eax" << std::endl;
-        out << prefix << "push eax" << std::endl;
+        return true;
     }
 };
 
@@ -358,193 +206,98 @@ public:
 class NBlock : public NStatement
 {
 public:
-    std::shared_ptr<StatementList> statements = std::make_shared<StatementList>();
+    StatementList statements;
 
     NBlock() {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NBlock";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        for (auto it = statements->begin(); it != statements->end(); it++)
-        {
-            (*it)->genAsmCode(out, prefix);
-            out << std::endl;
-        }
-    }
 };
 
 // 表达式语句
 class NExpressionStatement : public NStatement
 {
 public:
-    std::shared_ptr<NExpression> expression;
-
-    NExpressionStatement() {}
+    NExpression *expression;
 
-    NExpressionStatement(std::shared_ptr<NExpression> expression)
+    NExpressionStatement(NExpression *expression)
         : expression(expression) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NExpressionStatement";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        expression->genAsmCode(out, prefix);
-    }
 };
 
 // 单个变量声明语句
 class NVariableDeclarationInner : public NStatement
 {
 public:
-    const std::shared_ptr<NType> type;
-    std::shared_ptr<NIdentifier> id;
-    std::shared_ptr<NExpression> assignmentExpr;
-
-    NVariableDeclarationInner() {}
+    const CType type;
+    NIdentifier *id;
+    NExpression *assignmentExpr;
 
-    NVariableDeclarationInner(const std::shared_ptr<NType> type, std::shared_ptr<NIdentifier> id, std::shared_ptr<NExpression> assignmentExpr = nullptr)
+    NVariableDeclarationInner(CType type, NIdentifier *id, NExpression *assignmentExpr = nullptr)
         : type(type), id(id), assignmentExpr(assignmentExpr) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NVariableDeclarationInner";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        identifierTable.add(id->name);
-
-        if (assignmentExpr != nullptr)
-        {
-            assignmentExpr->genAsmCode(out, prefix);
-            out << prefix << "pop eax" << std::endl;
-            if (getEbpOffset(id->name) > 0)
-                out << prefix << "mov DWORD PTR [ebp+" << getEbpOffset(id->name) << "], eax" << std::endl;
-            else
-                out << prefix << "mov DWORD PTR [ebp-" << -getEbpOffset(id->name) << "], eax" << std::endl;
-        }
-    }
 };
 
 // 变量声明语句，其中可能包含多个变量声明
 class NVariableDeclaration : public NStatement
 {
 public:
-    std::shared_ptr<NType> defaultType = std::shared_ptr<NType>(new NType(CType::INT));
-    std::vector<std::shared_ptr<NVariableDeclarationInner>> variableDeclarationList;
+    std::vector<NVariableDeclarationInner *> variableDeclarationList;
 
     NVariableDeclaration() {}
 
-    NVariableDeclaration(std::shared_ptr<NType> defaultType) : defaultType(defaultType) {}
-
-    void addItem(std::shared_ptr<NIdentifier> id, const std::shared_ptr<NType> type = nullptr, std::shared_ptr<NExpression> assignmentExpr = nullptr)
+    void addItem(NVariableDeclarationInner *item)
     {
-        if (type == nullptr)
-        {
-            auto item = std::shared_ptr<NVariableDeclarationInner>(new NVariableDeclarationInner(defaultType, id, assignmentExpr));
-            variableDeclarationList.push_back(item);
-        }
-        else
-        {
-            auto item = std::shared_ptr<NVariableDeclarationInner>(new NVariableDeclarationInner(type, id, assignmentExpr));
-            variableDeclarationList.push_back(item);
-        }
+        variableDeclarationList.push_back(item);
     }
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NVariableDeclaration";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        for (auto it = variableDeclarationList.begin(); it != variableDeclarationList.end(); it++)
-        {
-            (*it)->genAsmCode(out, prefix);
-        }
-        out << std::endl;
-    }
 };
 
 // 函数定义语句
 class NFunctionDefine : public NStatement
 {
 public:
-    std::shared_ptr<NType> type;
-    std::shared_ptr<NIdentifier> id;
-    std::shared_ptr<NVariableDeclaration> arguments;
-    std::shared_ptr<NBlock> block;
+    CType type;
+    NIdentifier *id;
+    NVariableDeclaration *arguments;
+    NBlock *block;
+    int slotNum = 0; // 参数和局部变量的个数，由名字解析得到
 
-    NFunctionDefine(std::shared_ptr<NType> type, std::shared_ptr<NIdentifier> id, std::shared_ptr<NVariableDeclaration> arguments, std::shared_ptr<NBlock> block)
+    NFunctionDefine(CType type, NIdentifier *id, NVariableDeclaration *arguments, NBlock *block)
         : type(type), id(id), arguments(arguments), block(block) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NFunctionDefine";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        identifierTable.clear();
-
-        if (id->name == "main")
-        {
-            out << prefix << id->name << ":" << std::endl;
-        }
-        else
-        {
-            out << prefix << funcNamePrefix << id->name << ":" << std::endl;
-        }
-
-        auto nextPrefix = prefix + indent;
-
-        out << nextPrefix << "push ebp" << std::endl;
-        out << nextPrefix << "mov ebp, esp" << std::endl;
-        out << nextPrefix << "sub esp, 0x200" << std::endl; // 预留变量声明和定义所存放的空间
-
-        // 函数参数存储在标识符表中
-        for (auto i = 0; i < arguments->variableDeclarationList.size(); i++)
-        {
-            identifierTable.add(arguments->variableDeclarationList[i]->id->name, (i + 2) * 4);
-            // out << nextPrefix << "mov eax, DWORD PTR [ebp+" << (i + 2) * 4 << "]" << std::endl;
-            // out << nextPrefix << "mov DWORD PTR [ebp-" << getEbpOffset((arguments->variableDeclarationList[i])->id->name) << "], eax" << std::endl;
-        }
-        out << std::endl;
-
-        block->genAsmCode(out, nextPrefix);
-        out << nextPrefix << "leave" << std::endl;
-        out << nextPrefix << "ret" << std::endl;
-        out << std::endl;
-    }
 };
 
 // 返回语句
 class NReturnStatement : public NStatement
 {
 public:
-    std::shared_ptr<NExpression> expression;
+    NExpression *expression;
 
-    NReturnStatement(std::shared_ptr<NExpression> expression) : expression(expression) {}
+    NReturnStatement(NExpression *expression) : expression(expression) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NReturnStatement";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        expression->genAsmCode(out, prefix);
-        out << prefix << "pop eax" << std::endl;
-        out << prefix << "leave" << std::endl;
-        out << prefix << "ret" << std::endl;
-    }
 };
 
 // continue语句
@@ -553,15 +306,10 @@ class NContinueStatement : public NStatement
 public:
     NContinueStatement() {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NContinueStatement";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        out << prefix << "jmp " << labelPrefix << "whilecon_" << labelStack.top() << std::endl;
-    }
 };
 
 // break语句
@@ -570,99 +318,43 @@ class NBreakStatement : public NStatement
 public:
     NBreakStatement() {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NBreakStatement";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        out << prefix << "jmp " << labelPrefix << "whileend_" << labelStack.top() << std::endl;
-    }
 };
 
 // if语句
 class NIfStatement : public NStatement
 {
 public:
-    std::shared_ptr<NExpression> condition;
-    std::shared_ptr<NBlock> ifBlock;
-    std::shared_ptr<NBlock> elseBlock;
+    NExpression *condition;
+    NBlock *ifBlock;
+    NBlock *elseBlock;
 
-    NIfStatement(std::shared_ptr<NExpression> condition, std::shared_ptr<NBlock> ifBlock, std::shared_ptr<NBlock> elseBlock = nullptr)
+    NIfStatement(NExpression *condition, NBlock *ifBlock, NBlock *elseBlock = nullptr)
         : condition(condition), ifBlock(ifBlock), elseBlock(elseBlock) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NIfStatement";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        labelNo++;
-        int tempLabelNo = labelNo;
-        auto nextPrefix = prefix + indent;
-        out << prefix << labelPrefix << "ifcon_" << tempLabelNo << ":" << std::endl;
-        condition->genAsmCode(out, nextPrefix);
-        out << nextPrefix << "pop eax" << std::endl;
-        out << nextPrefix << "cmp eax, 0" << std::endl;
-        if (elseBlock != nullptr)
-        {
-            out << nextPrefix << "je " << labelPrefix << "else_" << tempLabelNo << std::endl;
-        }
-        else
-        {
-            out << nextPrefix << "je " << labelPrefix << "ifend_" << tempLabelNo << std::endl;
-        }
-        out << std::endl;
-
-        out << prefix << labelPrefix << "if_" << tempLabelNo << ":" << std::endl;
-        ifBlock->genAsmCode(out, nextPrefix);
-        out << nextPrefix << "jmp " << labelPrefix << "ifend_" << tempLabelNo << std::endl;
-        out << std::endl;
-        
-        if (elseBlock != nullptr)
-        {
-            out << prefix << labelPrefix << "else_" << tempLabelNo << ":" << std::endl;
-            elseBlock->genAsmCode(out, nextPrefix);
-        }
-        out << prefix << labelPrefix << "ifend_" << tempLabelNo << ":" << std::endl;
-    }
 };
 
 // while语句
 class NWhileStatement : public NStatement
 {
 public:
-    std::shared_ptr<NExpression> condition;
-    std::shared_ptr<NBlock> block;
+    NExpression *condition;
+    NBlock *block;
 
-    NWhileStatement(std::shared_ptr<NExpression> condition, std::shared_ptr<NBlock> block)
+    NWhileStatement(NExpression *condition, NBlock *block)
         : condition(condition), block(block) {}
 
-    std::string getTypeName() const override
+    const char *getTypeName() const override
     {
         return "NWhileStatement";
     }
-
-    void genAsmCode(std::ostream &out, std::string &prefix) const override
-    {
-        labelNo++;
-        labelStack.push(labelNo);
-        auto nextPrefix = prefix + indent;
-        out << prefix << labelPrefix << "whilecon_" << labelStack.top() << ":" << std::endl;
-        condition->genAsmCode(out, nextPrefix);
-        out << nextPrefix << "pop eax" << std::endl;
-        out << nextPrefix << "cmp eax, 0" << std::endl;
-        out << nextPrefix << "je " << labelPrefix << "whileend_" << labelStack.top() << std::endl;
-        out << std::endl;
-        out << prefix << labelPrefix << "while_" << labelStack.top() << ":" << std::endl;
-        block->genAsmCode(out, nextPrefix);
-        out << nextPrefix << "jmp " << labelPrefix << "whilecon_" << labelStack.top() << std::endl;
-        out << std::endl;
-        out << prefix << labelPrefix << "whileend_" << labelStack.top() << ":" << std::endl;
-        labelStack.pop();
-    }
 };
 
 #endif
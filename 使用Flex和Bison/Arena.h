@@ -0,0 +1,124 @@
+#ifndef __ARENA_H__
+#define __ARENA_H__
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// 语法树节点的分配器：从大块内存中顺序切分，不单独释放，整个编译结束时一起析构
+class NodeArena
+{
+public:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    NodeArena() {}
+
+    NodeArena(const NodeArena &) = delete;
+    NodeArena &operator=(const NodeArena &) = delete;
+
+    ~NodeArena()
+    {
+        clear();
+    }
+
+    // 在arena中构造一个对象，返回的指针在arena析构之前一直有效
+    template <typename T, typename... Args>
+    T *make(Args &&...args)
+    {
+        T *object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+        {
+            Finalizer finalizer;
+            finalizer.object = object;
+            finalizer.destroy = [](void *p)
+            { static_cast<T *>(p)->~T(); };
+            finalizers.push_back(finalizer);
+        }
+        objectNum++;
+        return object;
+    }
+
+    // 按构造的逆序析构所有对象并释放内存
+    void clear()
+    {
+        for (auto it = finalizers.rbegin(); it != finalizers.rend(); it++)
+        {
+            it->destroy(it->object);
+        }
+        finalizers.clear();
+        chunks.clear();
+        current = nullptr;
+        remaining = 0;
+        objectNum = 0;
+        usedBytes = 0;
+        reservedBytes = 0;
+    }
+
+    size_t getObjectNum() const
+    {
+        return objectNum;
+    }
+
+    // 对象实际占用的字节数，不含对齐填充
+    size_t getUsedBytes() const
+    {
+        return usedBytes;
+    }
+
+    // 向系统申请的字节数
+    size_t getReservedBytes() const
+    {
+        return reservedBytes;
+    }
+
+    size_t getChunkNum() const
+    {
+        return chunks.size();
+    }
+
+private:
+    struct Finalizer
+    {
+        void *object;
+        void (*destroy)(void *);
+    };
+
+    std::vector<std::unique_ptr<char[]>> chunks;
+    std::vector<Finalizer> finalizers;
+    char *current = nullptr; // 当前块中下一个空闲字节
+    size_t remaining = 0;    // 当前块剩余的字节数
+    size_t objectNum = 0;
+    size_t usedBytes = 0;
+    size_t reservedBytes = 0;
+
+    void *allocate(size_t size, size_t align)
+    {
+        size_t padding = (align - reinterpret_cast<size_t>(current) % align) % align;
+        if (current == nullptr || padding + size > remaining)
+        {
+            // 超过块大小的对象单独占一块，不浪费当前块的剩余空间
+            size_t chunkSize = size + align > CHUNK_SIZE ? size + align : CHUNK_SIZE;
+            chunks.emplace_back(new char[chunkSize]);
+            reservedBytes += chunkSize;
+            char *chunk = chunks.back().get();
+            padding = (align - reinterpret_cast<size_t>(chunk) % align) % align;
+            if (chunkSize != CHUNK_SIZE)
+            {
+                usedBytes += size;
+                return chunk + padding;
+            }
+            current = chunk;
+            remaining = chunkSize;
+        }
+        void *p = current + padding;
+        current += padding + size;
+        remaining -= padding + size;
+        usedBytes += size;
+        return p;
+    }
+};
+
+#endif
@@ -0,0 +1,539 @@
+#ifndef __ASMCODE_H__
+#define __ASMCODE_H__
+
+#include <stack>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "AsmWriter.h"
+#include "global.h"
+
+// 物理寄存器，前PHYS_REG_ALLOCATABLE个可以参与寄存器分配，R8~R15只在x86-64下使用
+// 运算都是32位的，x86-64下EAX、R8输出为eax、r8d，作为地址、压栈和保存时输出为rax、r8
+enum PhysReg
+{
+    EAX,
+    EBX,
+    ECX,
+    EDX,
+    ESI,
+    EDI,
+    R8,
+    R9,
+    R10,
+    R11,
+    R12,
+    R13,
+    R14,
+    R15,
+    ESP,
+    EBP,
+};
+
+const int PHYS_REG_ALLOCATABLE = 14;
+
+// x86-64下依次传递前ARG_REG_NUM个参数的寄存器
+const PhysReg ARG_REGS[] = {EDI, ESI, EDX, ECX, R8, R9};
+const int ARG_REG_NUM = 6;
+
+// 寄存器分配时依次尝试的寄存器，调用者保存寄存器不需要在函数入口保存，排在前面
+inline const std::vector<PhysReg> &allocatableRegs(Target target)
+{
+    static const std::vector<PhysReg> i386 = {EAX, ECX, EDX, EBX, ESI, EDI};
+    static const std::vector<PhysReg> x86_64 = {EAX, ECX, EDX, ESI, EDI, R8, R9, R10, R11,
+                                                EBX, R12, R13, R14, R15};
+    return target == TARGET_X86_64 ? x86_64 : i386;
+}
+
+// 被调用者保存寄存器，用到时要在序言中保存
+inline const std::vector<PhysReg> &calleeSavedRegs(Target target)
+{
+    static const std::vector<PhysReg> i386 = {EBX, ESI, EDI};
+    static const std::vector<PhysReg> x86_64 = {EBX, R12, R13, R14, R15};
+    return target == TARGET_X86_64 ? x86_64 : i386;
+}
+
+// 调用者保存寄存器，函数调用之后它们的值都不再可用
+inline const std::vector<PhysReg> &callerSavedRegs(Target target)
+{
+    static const std::vector<PhysReg> i386 = {EAX, ECX, EDX};
+    static const std::vector<PhysReg> x86_64 = {EAX, ECX, EDX, ESI, EDI, R8, R9, R10, R11};
+    return target == TARGET_X86_64 ? x86_64 : i386;
+}
+
+// 条件码，用于setcc和jcc
+enum CondCode
+{
+    CC_E,
+    CC_NE,
+    CC_L,
+    CC_LE,
+    CC_G,
+    CC_GE,
+};
+
+// 取反条件码
+inline CondCode invertCondCode(CondCode cc)
+{
+    switch (cc)
+    {
+    case CC_E:
+        return CC_NE;
+    case CC_NE:
+        return CC_E;
+    case CC_L:
+        return CC_GE;
+    case CC_LE:
+        return CC_G;
+    case CC_G:
+        return CC_LE;
+    default:
+        return CC_L;
+    }
+}
+
+// 交换比较的两个操作数后对应的条件码，a < b 等价于 b > a
+inline CondCode swapCondCode(CondCode cc)
+{
+    switch (cc)
+    {
+    case CC_L:
+        return CC_G;
+    case CC_LE:
+        return CC_GE;
+    case CC_G:
+        return CC_L;
+    case CC_GE:
+        return CC_LE;
+    default:
+        return cc;
+    }
+}
+
+// 操作数类型
+enum OperandKind
+{
+    OPD_NONE,
+    OPD_VREG,   // 虚拟寄存器
+    OPD_PREG,   // 物理寄存器
+    OPD_IMM,    // 立即数
+    OPD_MEM,    // 栈帧中的内存单元 DWORD PTR [ebp+value]
+    OPD_LABEL,  // 跳转标签
+    OPD_SYMBOL, // 外部符号，原样输出
+};
+
+// 指令的操作数
+struct Operand
+{
+    OperandKind kind = OPD_NONE;
+    int value = 0;    // 虚拟寄存器编号、物理寄存器、立即数或相对ebp的偏移
+    std::string name; // 标签名或符号名
+
+    static Operand vreg(int no)
+    {
+        Operand opd;
+        opd.kind = OPD_VREG;
+        opd.value = no;
+        return opd;
+    }
+
+    static Operand preg(PhysReg reg)
+    {
+        Operand opd;
+        opd.kind = OPD_PREG;
+        opd.value = reg;
+        return opd;
+    }
+
+    static Operand imm(int value)
+    {
+        Operand opd;
+        opd.kind = OPD_IMM;
+        opd.value = value;
+        return opd;
+    }
+
+    static Operand mem(int ebpOffset)
+    {
+        Operand opd;
+        opd.kind = OPD_MEM;
+        opd.value = ebpOffset;
+        return opd;
+    }
+
+    static Operand label(const std::string &name)
+    {
+        Operand opd;
+        opd.kind = OPD_LABEL;
+        opd.name = name;
+        return opd;
+    }
+
+    static Operand symbol(const std::string &name)
+    {
+        Operand opd;
+        opd.kind = OPD_SYMBOL;
+        opd.name = name;
+        return opd;
+    }
+
+    bool isVReg() const { return kind == OPD_VREG; }
+    bool isPReg(PhysReg reg) const { return kind == OPD_PREG && value == reg; }
+    bool isImm() const { return kind == OPD_IMM; }
+    bool isMem() const { return kind == OPD_MEM; }
+
+    bool operator==(const Operand &other) const
+    {
+        return kind == other.kind && value == other.value && name == other.name;
+    }
+
+    bool operator!=(const Operand &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+// 机器指令的操作码
+enum MOpcode
+{
+    M_LABEL, // 标签，a为标签名
+    M_MOV,
+    M_LEA,   // lea a, [b+b*scale]，即a = b * (scale + 1)，scale为1、2、4或8；b为符号时是lea a, b
+    M_ADD,
+    M_SUB,
+    M_IMUL,
+    M_AND,
+    M_OR,
+    M_XOR,
+    M_NEG,
+    M_NOT,
+    M_SAL,   // 第二个操作数为立即数或ecx
+    M_SAR,   // 第二个操作数为立即数或ecx
+    M_SHR,   // 逻辑右移，第二个操作数为立即数或ecx
+    M_CMP,
+    M_TEST,
+    M_SETCC, // 只写入al
+    M_MOVZX, // movzx a, al
+    M_CDQ,
+    M_IDIV,
+    M_IMULH, // 单操作数的imul a，edx:eax = eax * a，用于取乘积的高32位
+    M_PUSH,
+    M_CALL,
+    M_JMP,
+    M_JCC,
+    M_RET,   // 伪指令：恢复被调用者保存寄存器后leave; ret
+    M_TAILJMP, // 伪指令：恢复被调用者保存寄存器后leave; jmp a，用于尾调用
+};
+
+// 一条机器指令，操作数中可以出现虚拟寄存器，寄存器分配之后全部替换为物理寄存器或内存
+struct MInst
+{
+    MOpcode op;
+    Operand a;
+    Operand b;
+    CondCode cc = CC_E;
+    int scale = 0;     // M_LEA的比例因子
+    int regArgs = 0;   // x86-64下M_CALL和M_TAILJMP通过寄存器传递的参数个数
+    bool variadic = false; // x86-64下调用可变参数的函数，al中是通过向量寄存器传递的参数个数
+    int depth = 0;     // 输出时的缩进层数
+    int loopDepth = 0; // 所在循环的嵌套层数，用于估计溢出代价
+};
+
+// 函数内标签编号的分配状态
+struct LabelCounter
+{
+    int labelNo = 0;
+    std::stack<int> labelStack; // 所在循环的标签编号，用于continue和break
+};
+
+// 一个函数的机器指令序列
+class AsmFunction
+{
+public:
+    std::string name;           // 输出的函数标签
+    std::vector<MInst> insts;   // 指令序列
+    int vregNum = 0;            // 已经分配的虚拟寄存器数目
+    int frameSize = 0;          // 已经分配的栈上单元的字节数
+    int spillSlotNum = 0;       // 其中存放溢出的虚拟寄存器的单元个数
+    std::vector<std::pair<PhysReg, int>> savedRegs; // 需要保存的被调用者保存寄存器，及其在栈帧中的偏移
+    int depth = 1;              // 当前输出的缩进层数
+    int loopDepth = 0;          // 当前所在循环的嵌套层数
+    int stackDepth = 0;         // 为函数调用压栈、还没有弹出的字节数
+    Target target;
+    std::string labelPrefix;    // 函数中所有标签的前缀，含有函数名，不同函数的标签不会重名
+    LabelCounter labels;        // 标签编号，每个函数单独从1开始
+
+    AsmFunction(const std::string &name, const std::string &labelPrefix, Target target = TARGET_I386)
+        : name(name), target(target), labelPrefix(labelPrefix) {}
+
+    Operand newVReg()
+    {
+        return Operand::vreg(vregNum++);
+    }
+
+    // 在栈帧中分配一个单元，返回相对ebp的偏移
+    int allocSlot(int bytes = 4)
+    {
+        frameSize = (frameSize + bytes - 1) / bytes * bytes + bytes;
+        return -frameSize;
+    }
+
+    // 保存一个寄存器需要的字节数
+    int regBytes() const
+    {
+        return target == TARGET_X86_64 ? 8 : 4;
+    }
+
+    void emit(MOpcode op, const Operand &a = Operand(), const Operand &b = Operand())
+    {
+        MInst inst;
+        inst.op = op;
+        inst.a = a;
+        inst.b = b;
+        inst.depth = depth;
+        inst.loopDepth = loopDepth;
+        insts.push_back(inst);
+    }
+
+    void emitCond(MOpcode op, CondCode cc, const Operand &a = Operand())
+    {
+        emit(op, a);
+        insts.back().cc = cc;
+    }
+
+    // 标签输出在上一层缩进
+    void emitLabel(const std::string &label)
+    {
+        emit(M_LABEL, Operand::label(label));
+        insts.back().depth = depth - 1;
+    }
+
+    // 立即数不能作为某些指令的目的操作数，必要时先放入虚拟寄存器
+    Operand toReg(const Operand &opd)
+    {
+        if (opd.isVReg())
+        {
+            return opd;
+        }
+        Operand reg = newVReg();
+        emit(M_MOV, reg, opd);
+        return reg;
+    }
+
+    // 调用其他函数前要压栈bytes字节，先补齐使call时esp按16字节对齐，返回补齐的字节数
+    int alignCall(int bytes)
+    {
+        int pad = (16 - (stackDepth + bytes) % 16) % 16;
+        if (pad != 0)
+        {
+            emit(M_SUB, Operand::preg(ESP), Operand::imm(pad));
+            stackDepth += pad;
+        }
+        return pad;
+    }
+
+    bool hasCall() const
+    {
+        for (auto it = insts.begin(); it != insts.end(); it++)
+        {
+            if (it->op == M_CALL)
+                return true;
+        }
+        return false;
+    }
+
+    // 序言中实际预留的字节数，寄存器分配完成后才能确定
+    // 32位：进入函数时esp+4按16字节对齐，push ebp之后还差8字节，调用其他函数时补齐
+    // x86-64：进入函数时rsp+8按16字节对齐，push rbp之后正好对齐
+    int frameBytes() const
+    {
+        if (!hasCall())
+            return frameSize;
+        if (target == TARGET_X86_64)
+            return (frameSize + 15) / 16 * 16;
+        return (frameSize + 8 + 15) / 16 * 16 - 8;
+    }
+
+    // 输出寄存器分配完成后的汇编代码
+    void print(AsmWriter &out) const
+    {
+        out.depth = 1;
+        out << name << ":\n";
+        out.line() << "push " << wideRegName(EBP) << '\n';
+        out.line() << "mov " << wideRegName(EBP) << ", " << wideRegName(ESP) << '\n';
+        int bytes = frameBytes();
+        if (bytes != 0)
+        {
+            out.line() << "sub " << wideRegName(ESP) << ", " << bytes << '\n'; // 预留溢出的虚拟寄存器和被调用者保存寄存器所存放的空间
+        }
+        for (auto it = savedRegs.begin(); it != savedRegs.end(); it++)
+        {
+            out.line() << "mov ";
+            writeSlot(out, it->second);
+            out << ", " << wideRegName(it->first) << '\n';
+        }
+        out << '\n';
+
+        for (auto it = insts.begin(); it != insts.end(); it++)
+        {
+            printInst(out, *it);
+        }
+        out << '\n';
+    }
+
+    // 参与运算的32位寄存器名，x86-64下esp、ebp也按64位输出
+    const char *regName(int reg) const
+    {
+        static const char *names[] = {"eax", "ebx", "ecx", "edx", "esi", "edi", "r8d", "r9d", "r10d", "r11d",
+                                      "r12d", "r13d", "r14d", "r15d", "esp", "ebp"};
+        if (reg == ESP || reg == EBP)
+            return wideRegName(reg);
+        return names[reg];
+    }
+
+    // 作为地址、压栈和保存时使用的整个寄存器
+    const char *wideRegName(int reg) const
+    {
+        static const char *names[] = {"rax", "rbx", "rcx", "rdx", "rsi", "rdi", "r8", "r9", "r10", "r11",
+                                      "r12", "r13", "r14", "r15", "rsp", "rbp"};
+        static const char *names32[] = {"eax", "ebx", "ecx", "edx", "esi", "edi", "", "", "", "",
+                                        "", "", "", "", "esp", "ebp"};
+        return target == TARGET_X86_64 ? names[reg] : names32[reg];
+    }
+
+    static const char *condName(CondCode cc)
+    {
+        static const char *names[] = {"e", "ne", "l", "le", "g", "ge"};
+        return names[cc];
+    }
+
+    void writeOperand(AsmWriter &out, const Operand &opd) const
+    {
+        switch (opd.kind)
+        {
+        case OPD_VREG:
+            out << "%v" << opd.value;
+            break;
+        case OPD_PREG:
+            out << regName(opd.value);
+            break;
+        case OPD_IMM:
+            out << opd.value;
+            break;
+        case OPD_MEM:
+            out << "DWORD PTR ";
+            writeAddress(out, opd.value);
+            break;
+        default:
+            out << opd.name;
+            break;
+        }
+    }
+
+private:
+    void writeAddress(AsmWriter &out, int offset) const
+    {
+        if (offset > 0)
+            out << '[' << wideRegName(EBP) << '+' << offset << ']';
+        else
+            out << '[' << wideRegName(EBP) << '-' << -offset << ']';
+    }
+
+    // 保存被调用者保存寄存器的单元，x86-64下保存整个64位寄存器
+    void writeSlot(AsmWriter &out, int offset) const
+    {
+        out << (target == TARGET_X86_64 ? "QWORD PTR " : "DWORD PTR ");
+        writeAddress(out, offset);
+    }
+
+    void printInst(AsmWriter &out, const MInst &inst) const
+    {
+        static const char *mnemonics[] = {"", "mov", "lea", "add", "sub", "imul", "and", "or", "xor", "neg", "not",
+                                          "sal", "sar", "shr", "cmp", "test", "set", "movzx", "cdq", "idiv", "imul",
+                                          "push", "call", "jmp", "j", "", ""};
+        out.depth = inst.depth;
+        switch (inst.op)
+        {
+        case M_LABEL:
+            out << '\n';
+            out.line() << inst.a.name << ":\n";
+            return;
+        case M_RET:
+            for (auto it = savedRegs.begin(); it != savedRegs.end(); it++)
+            {
+                out.line() << "mov " << wideRegName(it->first) << ", ";
+                writeSlot(out, it->second);
+                out << '\n';
+            }
+            out.line() << "leave\n";
+            out.line() << "ret\n";
+            return;
+        case M_TAILJMP:
+            for (auto it = savedRegs.begin(); it != savedRegs.end(); it++)
+            {
+                out.line() << "mov " << wideRegName(it->first) << ", ";
+                writeSlot(out, it->second);
+                out << '\n';
+            }
+            out.line() << "leave\n";
+            out.line() << "jmp " << inst.a.name << '\n';
+            return;
+        case M_SETCC:
+            out.line() << "set" << condName(inst.cc) << " al\n";
+            return;
+        case M_MOVZX:
+            out.line() << "movzx ";
+            writeOperand(out, inst.a);
+            out << ", al\n";
+            return;
+        case M_JCC:
+            out.line() << 'j' << condName(inst.cc) << ' ';
+            writeOperand(out, inst.a);
+            out << '\n';
+            return;
+        case M_LEA:
+            out.line() << "lea ";
+            if (inst.b.kind == OPD_SYMBOL)
+            {
+                // x86-64下生成位置无关代码，符号的地址相对rip计算，结果是64位的
+                out << wideRegName(inst.a.value) << ", [rip+" << inst.b.name << "]\n";
+                return;
+            }
+            writeOperand(out, inst.a);
+            out << ", [" << wideRegName(inst.b.value) << '+' << wideRegName(inst.b.value) << '*' << inst.scale << "]\n";
+            return;
+        case M_PUSH:
+            // x86-64下压栈8字节，立即数符号扩展，寄存器用64位的名字
+            out.line() << "push ";
+            if (inst.a.kind == OPD_PREG)
+                out << wideRegName(inst.a.value);
+            else if (inst.a.kind == OPD_SYMBOL)
+                out << "offset " << inst.a.name; // 压入符号的地址
+            else
+                writeOperand(out, inst.a);
+            out << '\n';
+            return;
+        default:
+            break;
+        }
+        out.line() << mnemonics[inst.op];
+        if (inst.a.kind != OPD_NONE)
+        {
+            out << ' ';
+            writeOperand(out, inst.a);
+        }
+        if (inst.b.kind != OPD_NONE)
+        {
+            out << ", ";
+            // 移位次数放在ecx中时只能写cl
+            if ((inst.op == M_SAL || inst.op == M_SAR || inst.op == M_SHR) && inst.b.isPReg(ECX))
+                out << "cl";
+            else
+                writeOperand(out, inst.b);
+        }
+        out << '\n';
+    }
+};
+
+#endif
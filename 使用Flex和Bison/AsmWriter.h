@@ -0,0 +1,91 @@
+#ifndef __ASMWRITER_H__
+#define __ASMWRITER_H__
+
+#include <cerrno>
+#include <string>
+#include <unistd.h>
+
+// 汇编代码的输出缓冲区：所有输出先追加到内存中，最后用一次write写出
+class AsmWriter
+{
+public:
+    int depth = 0; // 当前的缩进层数，每层一个制表符
+
+    // reserveBytes是预先分配的缓冲区大小，整个文件的输出默认预留1MB
+    explicit AsmWriter(size_t reserveBytes = 1 << 20)
+    {
+        buffer.reserve(reserveBytes);
+    }
+
+    // 以当前的缩进开始新的一行
+    AsmWriter &line()
+    {
+        buffer.append(depth, '\t');
+        return *this;
+    }
+
+    AsmWriter &operator<<(const char *text)
+    {
+        buffer.append(text);
+        return *this;
+    }
+
+    AsmWriter &operator<<(const std::string &text)
+    {
+        buffer.append(text);
+        return *this;
+    }
+
+    AsmWriter &operator<<(char c)
+    {
+        buffer.push_back(c);
+        return *this;
+    }
+
+    AsmWriter &operator<<(int value)
+    {
+        char digits[12];
+        int len = 0;
+        unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+        do
+        {
+            digits[len++] = '0' + magnitude % 10;
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (value < 0)
+            buffer.push_back('-');
+        while (len > 0)
+            buffer.push_back(digits[--len]);
+        return *this;
+    }
+
+    const std::string &str() const
+    {
+        return buffer;
+    }
+
+    // 把缓冲区写到文件描述符fd，成功时返回true
+    bool writeTo(int fd) const
+    {
+        const char *data = buffer.data();
+        size_t remaining = buffer.size();
+        while (remaining > 0)
+        {
+            ssize_t written = ::write(fd, data, remaining);
+            if (written < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += written;
+            remaining -= written;
+        }
+        return true;
+    }
+
+private:
+    std::string buffer;
+};
+
+#endif
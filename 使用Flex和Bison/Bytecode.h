@@ -0,0 +1,113 @@
+#ifndef __BYTECODE_H__
+#define __BYTECODE_H__
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// --vm使用的寄存器式字节码，由BytecodeCompiler从语法树生成，由BytecodeVM解释执行
+// 每个函数有自己的一组寄存器：前slotNum个是参数和局部变量（编号就是变量的slot），之后是临时值
+// 调用时实参放在调用者连续的寄存器中，它们就是被调用函数的前几个寄存器，返回值写回第一个实参所在的寄存器
+enum BytecodeOp : uint8_t
+{
+    BC_MOV,   // a = b
+    BC_LOADI, // a = 立即数b
+
+    // a = b op c，c是寄存器
+    BC_ADD,
+    BC_SUB,
+    BC_MUL,
+    BC_DIV,
+    BC_MOD,
+    BC_AND,
+    BC_OR,
+    BC_XOR,
+    BC_SHL,
+    BC_SAR,
+
+    // a = b op c，c是立即数，顺序与上面相同
+    BC_ADDI,
+    BC_SUBI,
+    BC_MULI,
+    BC_DIVI,
+    BC_MODI,
+    BC_ANDI,
+    BC_ORI,
+    BC_XORI,
+    BC_SHLI,
+    BC_SARI,
+
+    BC_NEG, // a = -b
+    BC_NOT, // a = ~b
+
+    // a = b cmp c，结果为0或1，c是寄存器
+    BC_EQ,
+    BC_NE,
+    BC_LT,
+    BC_LE,
+    BC_GT,
+    BC_GE,
+
+    // c是立即数
+    BC_EQI,
+    BC_NEI,
+    BC_LTI,
+    BC_LEI,
+    BC_GTI,
+    BC_GEI,
+
+    BC_JMP, // 跳转到本条指令之后第c条（相对于本条指令的偏移）
+
+    // a cmp b成立时跳转，b是寄存器
+    BC_BEQ,
+    BC_BNE,
+    BC_BLT,
+    BC_BLE,
+    BC_BGT,
+    BC_BGE,
+
+    // b是立即数
+    BC_BEQI,
+    BC_BNEI,
+    BC_BLTI,
+    BC_BLEI,
+    BC_BGTI,
+    BC_BGEI,
+
+    BC_CALL,  // 调用第b个函数，实参从寄存器a开始，返回值写到寄存器a
+    BC_PRINT, // println_int(a)
+    BC_RET,   // 返回寄存器a
+    BC_RETI,  // 返回立即数a
+
+    BC_OP_NUM,
+};
+
+// 操作数是立即数的指令与对应的寄存器指令之间的距离，比较和条件跳转的距离相同
+const int BC_IMM_OFFSET = BC_ADDI - BC_ADD;
+const int BC_CMP_IMM_OFFSET = BC_EQI - BC_EQ;
+static_assert(BC_BEQI - BC_BEQ == BC_CMP_IMM_OFFSET, "branch and compare opcodes out of order");
+
+struct BytecodeInst
+{
+    uint8_t op = BC_MOV;
+    int a = 0;
+    int b = 0;
+    int c = 0;
+};
+
+struct BytecodeFunction
+{
+    std::string name;
+    int paramNum = 0;
+    int frameSize = 0; // 用到的寄存器个数
+    std::vector<BytecodeInst> code;
+};
+
+// 一个源文件编译得到的字节码，不引用语法树，语法树释放后仍然可以运行
+struct BytecodeProgram
+{
+    std::vector<BytecodeFunction> functions; // 按源代码中的顺序排列，CALL中是这里的下标
+    int mainIndex = -1;
+};
+
+#endif
@@ -0,0 +1,495 @@
+#ifndef __BYTECODECOMPILER_H__
+#define __BYTECODECOMPILER_H__
+
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include "ASTNodes.h"
+#include "Bytecode.h"
+
+// 从语法树生成--vm使用的字节码，需要在名字解析和常量折叠之后运行
+// 求值顺序与IRGenerator相同：实参从右向左，后求值的部分给变量赋值时先复制先求值的操作数
+// 临时寄存器按栈的方式分配，每条语句结束时全部释放
+class BytecodeCompiler
+{
+public:
+    int instNum = 0; // 生成的指令条数
+
+    explicit BytecodeCompiler(BytecodeProgram &program) : program(program) {}
+
+    void run(const NBlock *root)
+    {
+        // 函数可以在定义之前调用，先确定每个函数的下标
+        std::vector<const NFunctionDefine *> funcDefs;
+        for (auto it = root->statements.begin(); it != root->statements.end(); it++)
+        {
+            auto func = dynamic_cast<const NFunctionDefine *>(*it);
+            if (func == nullptr)
+                continue;
+            if (func->id->symbol->id == MAIN_SYMBOL_ID)
+                program.mainIndex = funcDefs.size();
+            functionIndex[func->id->symbol] = funcDefs.size();
+            funcDefs.push_back(func);
+        }
+
+        program.functions.resize(funcDefs.size());
+        for (size_t i = 0; i < funcDefs.size(); i++)
+        {
+            genFunction(funcDefs[i], program.functions[i]);
+            instNum += program.functions[i].code.size();
+        }
+    }
+
+private:
+    // 操作数：寄存器或立即数
+    struct Value
+    {
+        bool isImm;
+        int value;
+
+        static Value reg(int r) { return Value{false, r}; }
+        static Value imm(int v) { return Value{true, v}; }
+    };
+
+    // 循环中的continue和break，循环结束时回填
+    struct Loop
+    {
+        std::vector<int> continues;
+        std::vector<int> breaks;
+    };
+
+    BytecodeProgram &program;
+    std::unordered_map<const Symbol *, int> functionIndex;
+
+    BytecodeFunction *func = nullptr;
+    int slotNum = 0; // 参数和局部变量的个数，之后的寄存器是临时值
+    int top = 0;     // 下一个空闲的临时寄存器
+    std::vector<Loop> loops;
+
+    void genFunction(const NFunctionDefine *funcDef, BytecodeFunction &result)
+    {
+        func = &result;
+        result.name = funcDef->id->symbol->name;
+        result.paramNum = funcDef->arguments->variableDeclarationList.size();
+        slotNum = funcDef->slotNum;
+        top = slotNum;
+        result.frameSize = slotNum;
+        loops.clear();
+
+        genStatements(funcDef->block);
+        // 没有return时执行到末尾返回0
+        emit(BC_RETI);
+    }
+
+    // 分配连续的n个临时寄存器，返回第一个
+    int newTemp(int n = 1)
+    {
+        int r = top;
+        top += n;
+        if (top > func->frameSize)
+            func->frameSize = top;
+        return r;
+    }
+
+    // 返回指令的位置，跳转指令的目标之后用patch填写
+    int emit(int op, int a = 0, int b = 0, int c = 0)
+    {
+        BytecodeInst inst;
+        inst.op = op;
+        inst.a = a;
+        inst.b = b;
+        inst.c = c;
+        func->code.push_back(inst);
+        return func->code.size() - 1;
+    }
+
+    int here() const
+    {
+        return func->code.size();
+    }
+
+    void patch(const std::vector<int> &jumps, int target)
+    {
+        for (auto it = jumps.begin(); it != jumps.end(); it++)
+            func->code[*it].c = target - *it;
+    }
+
+    void genStatements(const NBlock *block)
+    {
+        if (block == nullptr)
+            return;
+        for (auto it = block->statements.begin(); it != block->statements.end(); it++)
+            genStatement(*it);
+    }
+
+    void genStatement(const NStatement *statement)
+    {
+        int savedTop = top;
+        if (auto n = dynamic_cast<const NExpressionStatement *>(statement))
+        {
+            genValue(n->expression);
+        }
+        else if (auto n = dynamic_cast<const NVariableDeclaration *>(statement))
+        {
+            for (auto it = n->variableDeclarationList.begin(); it != n->variableDeclarationList.end(); it++)
+            {
+                if ((*it)->assignmentExpr != nullptr)
+                    genValueInto((*it)->assignmentExpr, (*it)->id->slot);
+            }
+        }
+        else if (auto n = dynamic_cast<const NReturnStatement *>(statement))
+        {
+            Value value = genValue(n->expression);
+            emit(value.isImm ? BC_RETI : BC_RET, value.value);
+        }
+        else if (auto n = dynamic_cast<const NIfStatement *>(statement))
+        {
+            genIf(n);
+        }
+        else if (auto n = dynamic_cast<const NWhileStatement *>(statement))
+        {
+            genWhile(n);
+        }
+        else if (dynamic_cast<const NContinueStatement *>(statement) != nullptr)
+        {
+            loops.back().continues.push_back(emit(BC_JMP));
+        }
+        else if (dynamic_cast<const NBreakStatement *>(statement) != nullptr)
+        {
+            loops.back().breaks.push_back(emit(BC_JMP));
+        }
+        else if (auto n = dynamic_cast<const NBlock *>(statement))
+        {
+            genStatements(n);
+        }
+        top = savedTop;
+    }
+
+    void genIf(const NIfStatement *n)
+    {
+        std::vector<int> elseJumps;
+        genBranch(n->condition, false, elseJumps);
+        genStatements(n->ifBlock);
+        if (n->elseBlock != nullptr)
+        {
+            std::vector<int> endJumps(1, emit(BC_JMP));
+            patch(elseJumps, here());
+            genStatements(n->elseBlock);
+            patch(endJumps, here());
+        }
+        else
+        {
+            patch(elseJumps, here());
+        }
+    }
+
+    void genWhile(const NWhileStatement *n)
+    {
+        // 与IRGenerator相同，条件放在循环体之后
+        std::vector<int> entryJumps(1, emit(BC_JMP));
+        int body = here();
+        loops.push_back(Loop());
+        genStatements(n->block);
+        int condition = here();
+        patch(entryJumps, condition);
+        patch(loops.back().continues, condition);
+        std::vector<int> backJumps;
+        genBranch(n->condition, true, backJumps);
+        patch(backJumps, body);
+        patch(loops.back().breaks, here());
+        loops.pop_back();
+    }
+
+    // 计算表达式的值，返回存放结果的寄存器或立即数
+    Value genValue(const NExpression *expr)
+    {
+        if (auto n = dynamic_cast<const NInteger *>(expr))
+            return Value::imm(n->value);
+        if (auto n = dynamic_cast<const NIdentifier *>(expr))
+            return Value::reg(n->slot);
+        if (auto n = dynamic_cast<const NAssignment *>(expr))
+        {
+            genValueInto(n->right, n->left->slot);
+            return Value::reg(n->left->slot);
+        }
+        if (auto n = dynamic_cast<const NMethodCall *>(expr))
+            return Value::reg(genCall(n));
+        int dest = newTemp();
+        genValueInto(expr, dest);
+        return Value::reg(dest);
+    }
+
+    void genValueInto(const NExpression *expr, int dest)
+    {
+        if (auto n = dynamic_cast<const NBinaryOperatorExpression *>(expr))
+        {
+            genBinary(n, dest);
+        }
+        else if (auto n = dynamic_cast<const NUnaryOperatorExpression *>(expr))
+        {
+            genUnary(n, dest);
+        }
+        else
+        {
+            move(dest, genValue(expr));
+        }
+    }
+
+    void move(int dest, const Value &value)
+    {
+        if (value.isImm)
+            emit(BC_LOADI, dest, value.value);
+        else if (value.value != dest)
+            emit(BC_MOV, dest, value.value);
+    }
+
+    Value toReg(const Value &value)
+    {
+        if (!value.isImm)
+            return value;
+        int r = newTemp();
+        emit(BC_LOADI, r, value.value);
+        return Value::reg(r);
+    }
+
+    // 先求值的操作数是变量，而后求值的部分会给变量赋值时，先复制一份
+    Value protect(const Value &value, bool laterAssigns)
+    {
+        if (value.isImm || value.value >= slotNum || !laterAssigns)
+            return value;
+        int copy = newTemp();
+        emit(BC_MOV, copy, value.value);
+        return Value::reg(copy);
+    }
+
+    // 实参依次求值到从top开始的寄存器中，调用后返回值在第一个寄存器中
+    int genCall(const NMethodCall *n)
+    {
+        const ExpressionList &arguments = *n->arguments;
+        // 没有实参时也要留出存放返回值的寄存器
+        int base = newTemp(arguments.empty() ? 1 : arguments.size());
+        // 实参从右向左求值，每个实参求值后立即写到自己的寄存器中，之后的赋值不会影响它
+        for (size_t i = arguments.size(); i-- > 0;)
+            genValueInto(arguments[i], base + i);
+        if (n->id->symbol->id == PRINT_SYMBOL_ID)
+            emit(BC_PRINT, base);
+        else
+            emit(BC_CALL, base, functionIndex.at(n->id->symbol));
+        top = base + 1;
+        return base;
+    }
+
+    static bool isComparison(COperator op)
+    {
+        return op == CEQ || op == CNE || op == CLT || op == CLE || op == CGT || op == CGE;
+    }
+
+    // 交换两个操作数后等价的比较
+    static COperator swapComparison(COperator op)
+    {
+        switch (op)
+        {
+        case CLT:
+            return CGT;
+        case CLE:
+            return CGE;
+        case CGT:
+            return CLT;
+        case CGE:
+            return CLE;
+        default:
+            return op;
+        }
+    }
+
+    static COperator negateComparison(COperator op)
+    {
+        switch (op)
+        {
+        case CEQ:
+            return CNE;
+        case CNE:
+            return CEQ;
+        case CLT:
+            return CGE;
+        case CLE:
+            return CGT;
+        case CGT:
+            return CLE;
+        default:
+            return CLT;
+        }
+    }
+
+    void genBinary(const NBinaryOperatorExpression *n, int dest)
+    {
+        if (n->op == COperator::AND || n->op == COperator::OR)
+        {
+            // 短路求值，通过条件跳转得到0或1
+            std::vector<int> falseJumps;
+            genBranch(n, false, falseJumps);
+            emit(BC_LOADI, dest, 1);
+            std::vector<int> endJumps(1, emit(BC_JMP));
+            patch(falseJumps, here());
+            emit(BC_LOADI, dest, 0);
+            patch(endJumps, here());
+            return;
+        }
+
+        Value l = protect(genValue(n->left), n->right->hasAssignment());
+        Value r = genValue(n->right);
+        if (isComparison(n->op))
+        {
+            COperator op = n->op;
+            if (l.isImm && !r.isImm)
+            {
+                std::swap(l, r);
+                op = swapComparison(op);
+            }
+            l = toReg(l);
+            int base = BC_EQ + (op - CEQ);
+            emit(r.isImm ? base + BC_CMP_IMM_OFFSET : base, dest, l.value, r.value);
+            return;
+        }
+
+        int op;
+        bool commutative = false;
+        switch (n->op)
+        {
+        case COperator::PLUS:
+            op = BC_ADD;
+            commutative = true;
+            break;
+        case COperator::MINUS:
+            op = BC_SUB;
+            break;
+        case COperator::MUL:
+            op = BC_MUL;
+            commutative = true;
+            break;
+        case COperator::DIV:
+            op = BC_DIV;
+            break;
+        case COperator::MOD:
+            op = BC_MOD;
+            break;
+        case COperator::BITAND:
+            op = BC_AND;
+            commutative = true;
+            break;
+        case COperator::BITOR:
+            op = BC_OR;
+            commutative = true;
+            break;
+        case COperator::BITXOR:
+            op = BC_XOR;
+            commutative = true;
+            break;
+        case COperator::LSHIFT:
+            op = BC_SHL;
+            break;
+        case COperator::RSHIFT:
+            op = BC_SAR;
+            break;
+        default:
+            std::cerr << "[ERROR] Unknown operator: " << n->op << std::endl;
+            return;
+        }
+        if (l.isImm && !r.isImm && commutative)
+            std::swap(l, r);
+        l = toReg(l);
+        emit(r.isImm ? op + BC_IMM_OFFSET : op, dest, l.value, r.value);
+    }
+
+    void genUnary(const NUnaryOperatorExpression *n, int dest)
+    {
+        Value value = genValue(n->operand);
+        switch (n->op)
+        {
+        case COperator::NEG:
+            if (value.isImm)
+                emit(BC_LOADI, dest, (int)(0u - (unsigned)value.value));
+            else
+                emit(BC_NEG, dest, value.value);
+            break;
+        case COperator::BITNOT:
+            if (value.isImm)
+                emit(BC_LOADI, dest, ~value.value);
+            else
+                emit(BC_NOT, dest, value.value);
+            break;
+        case COperator::NOT:
+            if (value.isImm)
+                emit(BC_LOADI, dest, value.value == 0);
+            else
+                emit(BC_EQI, dest, value.value, 0);
+            break;
+        default:
+            std::cerr << "[ERROR] Unknown operator: " << n->op << std::endl;
+            break;
+        }
+    }
+
+    // 表达式的值非0与jumpIf相同时跳转，跳转指令加入jumps等待回填，否则顺序执行
+    void genBranch(const NExpression *expr, bool jumpIf, std::vector<int> &jumps)
+    {
+        if (auto n = dynamic_cast<const NInteger *>(expr))
+        {
+            if ((n->value != 0) == jumpIf)
+                jumps.push_back(emit(BC_JMP));
+            return;
+        }
+        if (auto n = dynamic_cast<const NUnaryOperatorExpression *>(expr))
+        {
+            if (n->op == COperator::NOT)
+            {
+                genBranch(n->operand, !jumpIf, jumps);
+                return;
+            }
+        }
+        if (auto n = dynamic_cast<const NBinaryOperatorExpression *>(expr))
+        {
+            if (n->op == COperator::AND || n->op == COperator::OR)
+            {
+                // 左操作数已经能决定结果时不再对右操作数求值
+                if ((n->op == COperator::AND) != jumpIf)
+                {
+                    genBranch(n->left, jumpIf, jumps);
+                    genBranch(n->right, jumpIf, jumps);
+                }
+                else
+                {
+                    std::vector<int> skipJumps;
+                    genBranch(n->left, !jumpIf, skipJumps);
+                    genBranch(n->right, jumpIf, jumps);
+                    patch(skipJumps, here());
+                }
+                return;
+            }
+            if (isComparison(n->op))
+            {
+                // 比较运算直接翻译为条件跳转，不生成0或1
+                Value l = protect(genValue(n->left), n->right->hasAssignment());
+                Value r = genValue(n->right);
+                emitBranch(jumpIf ? n->op : negateComparison(n->op), l, r, jumps);
+                return;
+            }
+        }
+        emitBranch(jumpIf ? CNE : CEQ, genValue(expr), Value::imm(0), jumps);
+    }
+
+    void emitBranch(COperator op, Value l, Value r, std::vector<int> &jumps)
+    {
+        if (l.isImm && !r.isImm)
+        {
+            std::swap(l, r);
+            op = swapComparison(op);
+        }
+        l = toReg(l);
+        int base = BC_BEQ + (op - CEQ);
+        jumps.push_back(emit(r.isImm ? base + BC_CMP_IMM_OFFSET : base, l.value, r.value));
+    }
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef __BYTECODEVM_H__
+#define __BYTECODEVM_H__
+
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <vector>
+
+#include "Bytecode.h"
+
+// 字节码解释器，运行结果与生成的机器码相同：
+// 整数运算按32位补码回绕，移位的位数取低5位，除以0和INT_MIN / -1与idiv一样产生SIGFPE
+// 寄存器和调用栈都在堆上，递归的深度不受编译器自身栈大小的限制
+// GCC和Clang下用computed goto，每条指令的末尾直接跳到下一条指令的处理代码，其他编译器退回到switch
+class BytecodeVM
+{
+public:
+    explicit BytecodeVM(const BytecodeProgram &program) : program(program) {}
+
+    // 从main开始运行，返回它的返回值，也就是程序的退出码
+    int run()
+    {
+        const BytecodeFunction &entry = program.functions[program.mainIndex];
+        registers.assign(INITIAL_REGISTERS > entry.frameSize ? INITIAL_REGISTERS : entry.frameSize, 0);
+        frames.clear();
+        int result = execute(entry);
+        std::fflush(stdout);
+        return result;
+    }
+
+private:
+    static const int INITIAL_REGISTERS = 1 << 16;
+
+    // 调用者的返回地址和寄存器的起始位置
+    struct Frame
+    {
+        const BytecodeInst *ret;
+        size_t base;
+    };
+
+    const BytecodeProgram &program;
+    std::vector<int> registers;
+    std::vector<Frame> frames;
+
+    static bool divisionTraps(int l, int r)
+    {
+        return r == 0 || (l == INT_MIN && r == -1);
+    }
+
+    static void divisionError()
+    {
+        std::raise(SIGFPE);
+    }
+
+    int execute(const BytecodeFunction &entry)
+    {
+        const BytecodeInst *pc = entry.code.data();
+        size_t base = 0;
+        int *r = registers.data();
+
+#if defined(__GNUC__)
+        // 顺序与BytecodeOp相同
+        static void *const handlers[] = {
+            &&op_MOV, &&op_LOADI,
+            &&op_ADD, &&op_SUB, &&op_MUL, &&op_DIV, &&op_MOD, &&op_AND, &&op_OR, &&op_XOR, &&op_SHL, &&op_SAR,
+            &&op_ADDI, &&op_SUBI, &&op_MULI, &&op_DIVI, &&op_MODI, &&op_ANDI, &&op_ORI, &&op_XORI, &&op_SHLI, &&op_SARI,
+            &&op_NEG, &&op_NOT,
+            &&op_EQ, &&op_NE, &&op_LT, &&op_LE, &&op_GT, &&op_GE,
+            &&op_EQI, &&op_NEI, &&op_LTI, &&op_LEI, &&op_GTI, &&op_GEI,
+            &&op_JMP,
+            &&op_BEQ, &&op_BNE, &&op_BLT, &&op_BLE, &&op_BGT, &&op_BGE,
+            &&op_BEQI, &&op_BNEI, &&op_BLTI, &&op_BLEI, &&op_BGTI, &&op_BGEI,
+            &&op_CALL, &&op_PRINT, &&op_RET, &&op_RETI,
+        };
+        static_assert(sizeof(handlers) / sizeof(handlers[0]) == BC_OP_NUM, "handlers out of sync with BytecodeOp");
+#define VM_DISPATCH() goto *handlers[pc->op]
+#define VM_CASE(name) op_##name:
+#else
+#define VM_DISPATCH() goto dispatch
+#define VM_CASE(name) case BC_##name:
+#endif
+#define VM_NEXT()      \
+    do                 \
+    {                  \
+        pc++;          \
+        VM_DISPATCH(); \
+    } while (0)
+#define VM_BINARY(name, expr)      \
+    VM_CASE(name)                  \
+    {                              \
+        int x = r[pc->b];          \
+        int y = r[pc->c];          \
+        r[pc->a] = (expr);         \
+        VM_NEXT();                 \
+    }                              \
+    VM_CASE(name##I)               \
+    {                              \
+        int x = r[pc->b];          \
+        int y = pc->c;             \
+        r[pc->a] = (expr);         \
+        VM_NEXT();                 \
+    }
+#define VM_BRANCH(name, cmp)                     \
+    VM_CASE(B##name)                             \
+    {                                            \
+        pc += r[pc->a] cmp r[pc->b] ? pc->c : 1; \
+        VM_DISPATCH();                           \
+    }                                            \
+    VM_CASE(B##name##I)                          \
+    {                                            \
+        pc += r[pc->a] cmp pc->b ? pc->c : 1;    \
+        VM_DISPATCH();                           \
+    }
+
+#if defined(__GNUC__)
+        VM_DISPATCH();
+#else
+    dispatch:
+        switch (pc->op)
+        {
+#endif
+        VM_CASE(MOV)
+        {
+            r[pc->a] = r[pc->b];
+            VM_NEXT();
+        }
+        VM_CASE(LOADI)
+        {
+            r[pc->a] = pc->b;
+            VM_NEXT();
+        }
+
+        // 在unsigned上运算，溢出时回绕而不是未定义行为
+        VM_BINARY(ADD, (int)((unsigned)x + (unsigned)y))
+        VM_BINARY(SUB, (int)((unsigned)x - (unsigned)y))
+        VM_BINARY(MUL, (int)((unsigned)x * (unsigned)y))
+        VM_BINARY(DIV, (divisionTraps(x, y) ? (divisionError(), 0) : x / y))
+        VM_BINARY(MOD, (divisionTraps(x, y) ? (divisionError(), 0) : x % y))
+        VM_BINARY(AND, x & y)
+        VM_BINARY(OR, x | y)
+        VM_BINARY(XOR, x ^ y)
+        VM_BINARY(SHL, (int)((unsigned)x << (y & 31)))
+        VM_BINARY(SAR, x >> (y & 31))
+
+        VM_CASE(NEG)
+        {
+            r[pc->a] = (int)(0u - (unsigned)r[pc->b]);
+            VM_NEXT();
+        }
+        VM_CASE(NOT)
+        {
+            r[pc->a] = ~r[pc->b];
+            VM_NEXT();
+        }
+
+        VM_CASE(EQ)
+        {
+            r[pc->a] = r[pc->b] == r[pc->c];
+            VM_NEXT();
+        }
+        VM_CASE(NE)
+        {
+            r[pc->a] = r[pc->b] != r[pc->c];
+            VM_NEXT();
+        }
+        VM_CASE(LT)
+        {
+            r[pc->a] = r[pc->b] < r[pc->c];
+            VM_NEXT();
+        }
+        VM_CASE(LE)
+        {
+            r[pc->a] = r[pc->b] <= r[pc->c];
+            VM_NEXT();
+        }
+        VM_CASE(GT)
+        {
+            r[pc->a] = r[pc->b] > r[pc->c];
+            VM_NEXT();
+        }
+        VM_CASE(GE)
+        {
+            r[pc->a] = r[pc->b] >= r[pc->c];
+            VM_NEXT();
+        }
+        VM_CASE(EQI)
+        {
+            r[pc->a] = r[pc->b] == pc->c;
+            VM_NEXT();
+        }
+        VM_CASE(NEI)
+        {
+            r[pc->a] = r[pc->b] != pc->c;
+            VM_NEXT();
+        }
+        VM_CASE(LTI)
+        {
+            r[pc->a] = r[pc->b] < pc->c;
+            VM_NEXT();
+        }
+        VM_CASE(LEI)
+        {
+            r[pc->a] = r[pc->b] <= pc->c;
+            VM_NEXT();
+        }
+        VM_CASE(GTI)
+        {
+            r[pc->a] = r[pc->b] > pc->c;
+            VM_NEXT();
+        }
+        VM_CASE(GEI)
+        {
+            r[pc->a] = r[pc->b] >= pc->c;
+            VM_NEXT();
+        }
+
+        VM_CASE(JMP)
+        {
+            pc += pc->c;
+            VM_DISPATCH();
+        }
+        VM_BRANCH(EQ, ==)
+        VM_BRANCH(NE, !=)
+        VM_BRANCH(LT, <)
+        VM_BRANCH(LE, <=)
+        VM_BRANCH(GT, >)
+        VM_BRANCH(GE, >=)
+
+        VM_CASE(CALL)
+        {
+            const BytecodeFunction &callee = program.functions[pc->b];
+            frames.push_back(Frame{pc + 1, base});
+            base += pc->a;
+            // 扩大之后原来的指针失效，重新取寄存器的起始地址
+            if (base + callee.frameSize > registers.size())
+                registers.resize((base + callee.frameSize) * 2);
+            r = registers.data() + base;
+            pc = callee.code.data();
+            VM_DISPATCH();
+        }
+        VM_CASE(PRINT)
+        {
+            std::printf("%d\n", r[pc->a]);
+            VM_NEXT();
+        }
+        VM_CASE(RET)
+        {
+            int value = r[pc->a];
+            if (frames.empty())
+                return value;
+            // 被调用函数的第0个寄存器就是调用者存放返回值的寄存器
+            r[0] = value;
+            pc = frames.back().ret;
+            base = frames.back().base;
+            frames.pop_back();
+            r = registers.data() + base;
+            VM_DISPATCH();
+        }
+        VM_CASE(RETI)
+        {
+            int value = pc->a;
+            if (frames.empty())
+                return value;
+            r[0] = value;
+            pc = frames.back().ret;
+            base = frames.back().base;
+            frames.pop_back();
+            r = registers.data() + base;
+            VM_DISPATCH();
+        }
+#if !defined(__GNUC__)
+        default:
+            break;
+        }
+#endif
+        return 0;
+
+#undef VM_BRANCH
+#undef VM_BINARY
+#undef VM_NEXT
+#undef VM_CASE
+#undef VM_DISPATCH
+    }
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef __COMPILATIONCONTEXT_H__
+#define __COMPILATIONCONTEXT_H__
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "Arena.h"
+#include "AsmWriter.h"
+#include "Bytecode.h"
+#include "MachineCode.h"
+#include "SourceFile.h"
+#include "Symbol.h"
+#include "TaskPool.h"
+
+class NBlock;
+
+// 编译一个源文件所需的全部状态，编译器中不再有可变的全局变量
+// 每个源文件使用自己的上下文，不同的上下文可以在不同的线程中同时编译
+class CompilationContext
+{
+public:
+    std::string sourceFileName;
+    SourceFile source;              // 源文件的内存映射，词法分析直接扫描它
+    void *scanner = nullptr;        // flex的可重入扫描器(yyscan_t)
+    SymbolTable symbols;            // 标识符驻留表
+    NodeArena arena;                // 语法树节点都分配在这里，上下文销毁时一起释放
+    NBlock *program = nullptr;      // 语法分析得到的语法树
+    AsmWriter out;                  // 生成的汇编代码或目标文件
+    std::vector<MachineCode> functions; // -c和--jit时各个函数的机器码，按源代码中的顺序排列
+    BytecodeProgram bytecode;       // --vm时的字节码
+    std::ostringstream diagnostics; // 错误和统计信息，编译结束后再输出，多个文件的信息不会交错
+    TaskPool *pool = nullptr;       // 用来并行生成各个函数的代码
+
+    explicit CompilationContext(const std::string &sourceFileName) : sourceFileName(sourceFileName) {}
+
+    CompilationContext(const CompilationContext &) = delete;
+    CompilationContext &operator=(const CompilationContext &) = delete;
+};
+
+#endif
@@ -0,0 +1,404 @@
+#ifndef __CONSTANTFOLDER_H__
+#define __CONSTANTFOLDER_H__
+
+#include <climits>
+#include <map>
+#include <set>
+#include <string>
+
+#include "ASTNodes.h"
+#include "Arena.h"
+
+// 常量折叠与常量传播：在生成代码之前改写语法树
+// 常量子树替换为NInteger，直线代码中已知值的局部变量替换为它的值
+// 需要在名字解析之后运行，变量按编号区分，内层同名变量不会和外层混淆
+class ConstantFolder
+{
+public:
+    int foldedNum = 0;     // 折叠掉的运算个数
+    int propagatedNum = 0; // 替换为常量的变量引用个数
+
+    // 新生成的节点分配在语法树所在的arena中
+    ConstantFolder(NodeArena &arena) : arena(arena) {}
+
+    void run(NBlock *program)
+    {
+        for (auto it = program->statements.begin(); it != program->statements.end(); it++)
+        {
+            auto func = dynamic_cast<NFunctionDefine *>(*it);
+            if (func != nullptr)
+            {
+                ConstantEnv env;
+                foldBlock(func->block, env);
+            }
+        }
+    }
+
+    // 按C语言的语义计算二元运算，结果未定义或运行时会出错（除零、溢出、移位越界）时返回false
+    static bool evalBinary(COperator op, int l, int r, int &result)
+    {
+        switch (op)
+        {
+        case COperator::PLUS:
+            result = (int)((unsigned)l + (unsigned)r);
+            return true;
+        case COperator::MINUS:
+            result = (int)((unsigned)l - (unsigned)r);
+            return true;
+        case COperator::MUL:
+            result = (int)((unsigned)l * (unsigned)r);
+            return true;
+        case COperator::DIV:
+        case COperator::MOD:
+            if (r == 0 || (l == INT_MIN && r == -1))
+                return false;
+            result = op == COperator::DIV ? l / r : l % r;
+            return true;
+        case COperator::LSHIFT:
+        case COperator::RSHIFT:
+            if (r < 0 || r > 31)
+                return false;
+            result = op == COperator::LSHIFT ? (int)((unsigned)l << r) : l >> r;
+            return true;
+        case COperator::CEQ:
+            result = l == r;
+            return true;
+        case COperator::CNE:
+            result = l != r;
+            return true;
+        case COperator::CLT:
+            result = l < r;
+            return true;
+        case COperator::CLE:
+            result = l <= r;
+            return true;
+        case COperator::CGT:
+            result = l > r;
+            return true;
+        case COperator::CGE:
+            result = l >= r;
+            return true;
+        case COperator::BITAND:
+            result = l & r;
+            return true;
+        case COperator::BITOR:
+            result = l | r;
+            return true;
+        case COperator::BITXOR:
+            result = l ^ r;
+            return true;
+        case COperator::AND:
+            result = l && r;
+            return true;
+        case COperator::OR:
+            result = l || r;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    static bool evalUnary(COperator op, int value, int &result)
+    {
+        switch (op)
+        {
+        case COperator::NEG:
+            result = (int)(0u - (unsigned)value);
+            return true;
+        case COperator::BITNOT:
+            result = ~value;
+            return true;
+        case COperator::NOT:
+            result = !value;
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // 收集语句或表达式中被赋值的变量编号
+    static void collectAssigned(const Node *node, std::set<int> &slots)
+    {
+        if (node == nullptr)
+            return;
+        if (auto n = dynamic_cast<const NAssignment *>(node))
+        {
+            slots.insert(n->left->slot);
+            collectAssigned(n->right, slots);
+        }
+        else if (auto n = dynamic_cast<const NBinaryOperatorExpression *>(node))
+        {
+            collectAssigned(n->left, slots);
+            collectAssigned(n->right, slots);
+        }
+        else if (auto n = dynamic_cast<const NUnaryOperatorExpression *>(node))
+        {
+            collectAssigned(n->operand, slots);
+        }
+        else if (auto n = dynamic_cast<const NMethodCall *>(node))
+        {
+            for (auto it = n->arguments->begin(); it != n->arguments->end(); it++)
+                collectAssigned(*it, slots);
+        }
+        else if (auto n = dynamic_cast<const NBlock *>(node))
+        {
+            for (auto it = n->statements.begin(); it != n->statements.end(); it++)
+                collectAssigned(*it, slots);
+        }
+        else if (auto n = dynamic_cast<const NExpressionStatement *>(node))
+        {
+            collectAssigned(n->expression, slots);
+        }
+        else if (auto n = dynamic_cast<const NVariableDeclaration *>(node))
+        {
+            for (auto it = n->variableDeclarationList.begin(); it != n->variableDeclarationList.end(); it++)
+            {
+                slots.insert((*it)->id->slot);
+                collectAssigned((*it)->assignmentExpr, slots);
+            }
+        }
+        else if (auto n = dynamic_cast<const NReturnStatement *>(node))
+        {
+            collectAssigned(n->expression, slots);
+        }
+        else if (auto n = dynamic_cast<const NIfStatement *>(node))
+        {
+            collectAssigned(n->condition, slots);
+            collectAssigned(n->ifBlock, slots);
+            collectAssigned(n->elseBlock, slots);
+        }
+        else if (auto n = dynamic_cast<const NWhileStatement *>(node))
+        {
+            collectAssigned(n->condition, slots);
+            collectAssigned(n->block, slots);
+        }
+    }
+
+private:
+    NodeArena &arena;
+
+    // 变量编号到已知常量值的映射
+    typedef std::map<int, int> ConstantEnv;
+
+    // 控制流汇合处只保留两边值相同的变量
+    static void intersect(ConstantEnv &env, const ConstantEnv &other)
+    {
+        for (auto it = env.begin(); it != env.end();)
+        {
+            auto found = other.find(it->first);
+            if (found == other.end() || found->second != it->second)
+                it = env.erase(it);
+            else
+                it++;
+        }
+    }
+
+    static bool isConstant(const NExpression *expr, int &value)
+    {
+        auto integer = dynamic_cast<const NInteger *>(expr);
+        if (integer == nullptr)
+            return false;
+        value = integer->value;
+        return true;
+    }
+
+    NExpression *makeInteger(int value)
+    {
+        foldedNum++;
+        return arena.make<NInteger>(value);
+    }
+
+    // expr != 0，用于把逻辑运算的操作数规范为0或1
+    NExpression *makeBoolean(NExpression *expr)
+    {
+        return arena.make<NBinaryOperatorExpression>(expr, COperator::CNE, arena.make<NInteger>(0));
+    }
+
+    void foldBlock(NBlock *block, ConstantEnv &env)
+    {
+        for (auto it = block->statements.begin(); it != block->statements.end(); it++)
+        {
+            foldStatement(*it, env);
+        }
+    }
+
+    void foldStatement(NStatement *statement, ConstantEnv &env)
+    {
+        if (auto n = dynamic_cast<NExpressionStatement *>(statement))
+        {
+            n->expression = foldExpression(n->expression, env);
+        }
+        else if (auto n = dynamic_cast<NVariableDeclaration *>(statement))
+        {
+            for (auto it = n->variableDeclarationList.begin(); it != n->variableDeclarationList.end(); it++)
+            {
+                auto &item = *it;
+                int value;
+                if (item->assignmentExpr != nullptr)
+                    item->assignmentExpr = foldExpression(item->assignmentExpr, env);
+                if (item->assignmentExpr != nullptr && isConstant(item->assignmentExpr, value))
+                    env[item->id->slot] = value;
+                else
+                    env.erase(item->id->slot);
+            }
+        }
+        else if (auto n = dynamic_cast<NReturnStatement *>(statement))
+        {
+            n->expression = foldExpression(n->expression, env);
+        }
+        else if (auto n = dynamic_cast<NIfStatement *>(statement))
+        {
+            n->condition = foldExpression(n->condition, env);
+            ConstantEnv ifEnv = env;
+            ConstantEnv elseEnv = env;
+            foldBlock(n->ifBlock, ifEnv);
+            if (n->elseBlock != nullptr)
+                foldBlock(n->elseBlock, elseEnv);
+
+            int value;
+            if (isConstant(n->condition, value))
+            {
+                env = value ? ifEnv : elseEnv;
+            }
+            else
+            {
+                env = ifEnv;
+                intersect(env, elseEnv);
+            }
+        }
+        else if (auto n = dynamic_cast<NWhileStatement *>(statement))
+        {
+            // 循环中被赋值的变量在循环入口和出口处都不再已知
+            std::set<int> assigned;
+            collectAssigned(n, assigned);
+            for (auto it = assigned.begin(); it != assigned.end(); it++)
+                env.erase(*it);
+
+            n->condition = foldExpression(n->condition, env);
+            ConstantEnv bodyEnv = env;
+            foldBlock(n->block, bodyEnv);
+            for (auto it = assigned.begin(); it != assigned.end(); it++)
+                env.erase(*it);
+        }
+    }
+
+    NExpression *foldExpression(NExpression *expr, ConstantEnv &env)
+    {
+        if (auto n = dynamic_cast<NIdentifier *>(expr))
+        {
+            auto found = env.find(n->slot);
+            if (found != env.end())
+            {
+                propagatedNum++;
+                return arena.make<NInteger>(found->second);
+            }
+            return expr;
+        }
+        if (auto n = dynamic_cast<NAssignment *>(expr))
+        {
+            int value;
+            n->right = foldExpression(n->right, env);
+            if (isConstant(n->right, value))
+                env[n->left->slot] = value;
+            else
+                env.erase(n->left->slot);
+            return expr;
+        }
+        if (auto n = dynamic_cast<NMethodCall *>(expr))
+        {
+            // 与代码生成一致，参数从右向左求值
+            for (auto it = n->arguments->rbegin(); it != n->arguments->rend(); it++)
+                *it = foldExpression(*it, env);
+            return expr;
+        }
+        if (auto n = dynamic_cast<NUnaryOperatorExpression *>(expr))
+        {
+            int value, result;
+            n->operand = foldExpression(n->operand, env);
+            if (isConstant(n->operand, value) && evalUnary(n->op, value, result))
+                return makeInteger(result);
+            return expr;
+        }
+        if (auto n = dynamic_cast<NBinaryOperatorExpression *>(expr))
+        {
+            if (n->op == COperator::AND || n->op == COperator::OR)
+                return foldLogical(n, env);
+            return foldBinary(n, env);
+        }
+        return expr;
+    }
+
+    // &&和||：右操作数不一定求值
+    NExpression *foldLogical(NBinaryOperatorExpression *n, ConstantEnv &env)
+    {
+        bool isAnd = n->op == COperator::AND;
+        int l = 0, r = 0;
+        n->left = foldExpression(n->left, env);
+        if (isConstant(n->left, l))
+        {
+            // 0 && x 和 1 || x 不对x求值
+            if (isAnd == !l)
+                return makeInteger(l ? 1 : 0);
+            n->right = foldExpression(n->right, env);
+            if (isConstant(n->right, r))
+                return makeInteger(r ? 1 : 0);
+            foldedNum++;
+            return makeBoolean(n->right);
+        }
+
+        ConstantEnv rightEnv = env;
+        n->right = foldExpression(n->right, rightEnv);
+        intersect(env, rightEnv);
+        if (isConstant(n->right, r) && !n->left->hasSideEffect() && isAnd == !r)
+            return makeInteger(r ? 1 : 0);
+        return n;
+    }
+
+    NExpression *foldBinary(NBinaryOperatorExpression *n, ConstantEnv &env)
+    {
+        int l = 0, r = 0, result = 0;
+        n->left = foldExpression(n->left, env);
+        n->right = foldExpression(n->right, env);
+        bool leftConstant = isConstant(n->left, l);
+        bool rightConstant = isConstant(n->right, r);
+        COperator op = n->op;
+        if (leftConstant && rightConstant)
+        {
+            if (evalBinary(op, l, r, result))
+                return makeInteger(result);
+            return n;
+        }
+
+        // 代数恒等式
+        if (rightConstant)
+        {
+            if ((r == 0 && (op == COperator::PLUS || op == COperator::MINUS || op == COperator::BITOR ||
+                            op == COperator::BITXOR || op == COperator::LSHIFT || op == COperator::RSHIFT)) ||
+                (r == 1 && (op == COperator::MUL || op == COperator::DIV)) ||
+                (r == -1 && op == COperator::BITAND))
+            {
+                foldedNum++;
+                return n->left;
+            }
+            if (!n->left->hasSideEffect() &&
+                ((r == 0 && (op == COperator::MUL || op == COperator::BITAND)) ||
+                 ((r == 1 || r == -1) && op == COperator::MOD)))
+                return makeInteger(0);
+        }
+        if (leftConstant)
+        {
+            if ((l == 0 && (op == COperator::PLUS || op == COperator::BITOR || op == COperator::BITXOR)) ||
+                (l == 1 && op == COperator::MUL) ||
+                (l == -1 && op == COperator::BITAND))
+            {
+                foldedNum++;
+                return n->right;
+            }
+            if (!n->right->hasSideEffect() && l == 0 && (op == COperator::MUL || op == COperator::BITAND))
+                return makeInteger(0);
+        }
+        return n;
+    }
+};
+
+#endif
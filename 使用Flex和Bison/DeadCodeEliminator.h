@@ -0,0 +1,265 @@
+#ifndef __DEADCODEELIMINATOR_H__
+#define __DEADCODEELIMINATOR_H__
+
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "IR.h"
+#include "IRAnalysis.h"
+
+// 死代码删除：在IR上反复执行以下几步，直到没有变化
+// 1. 两边都是常量的条件跳转改为无条件跳转，if (0)、while (0)的循环体因此不可达
+// 2. 只有一条jmp的基本块让前驱直接跳到最终目标
+// 3. 删除从入口不可达的基本块，return、break、continue之后的语句都在这样的块中
+// 4. 合并只能从上一个块顺序执行到的块
+// 5. 根据活跃变量分析删除结果不会被用到的指令，包括从不读取的局部变量的赋值
+class DeadCodeEliminator
+{
+public:
+    int removedInstNum = 0;  // 删除的指令条数，不含合并基本块时去掉的jmp
+    int removedBlockNum = 0; // 删除和合并掉的基本块个数
+
+    DeadCodeEliminator(IRFunction &func) : func(func) {}
+
+    void run()
+    {
+        func.computeCFG();
+        bool changed = true;
+        while (changed)
+        {
+            changed = foldBranches();
+            changed |= threadJumps();
+            changed |= removeUnreachable();
+            changed |= mergeBlocks();
+            changed |= removeDeadStores();
+        }
+    }
+
+    // 按C语言的语义计算比较运算
+    static bool evalCompare(COperator cmp, int l, int r)
+    {
+        switch (cmp)
+        {
+        case CEQ:
+            return l == r;
+        case CNE:
+            return l != r;
+        case CLT:
+            return l < r;
+        case CLE:
+            return l <= r;
+        case CGT:
+            return l > r;
+        default:
+            return l >= r;
+        }
+    }
+
+private:
+    IRFunction &func;
+
+    bool foldBranches()
+    {
+        bool changed = false;
+        for (auto block = func.blocks.begin(); block != func.blocks.end(); block++)
+        {
+            IRInst &term = block->insts.back();
+            if (term.op != IR_BR)
+                continue;
+            if (term.a.isImm() && term.b.isImm())
+            {
+                if (!evalCompare(term.cmp, term.a.value, term.b.value))
+                    term.target = term.falseTarget;
+            }
+            else if (term.target != term.falseTarget)
+            {
+                continue;
+            }
+            term.op = IR_JMP;
+            term.a = term.b = IRValue();
+            term.falseTarget = -1;
+            changed = true;
+        }
+        if (changed)
+            func.computeCFG();
+        return changed;
+    }
+
+    // 空循环while (1) {}会形成只有jmp的环，此时保留原来的目标
+    int finalTarget(int block) const
+    {
+        int target = block;
+        for (size_t hops = 0; hops < func.blocks.size(); hops++)
+        {
+            const IRBlock &b = func.blocks[target];
+            if (b.id == 0 || b.insts.size() != 1 || b.insts[0].op != IR_JMP)
+                return target;
+            target = b.insts[0].target;
+        }
+        return block;
+    }
+
+    bool threadJumps()
+    {
+        bool changed = false;
+        for (auto block = func.blocks.begin(); block != func.blocks.end(); block++)
+        {
+            IRInst &term = block->insts.back();
+            if (term.op != IR_JMP && term.op != IR_BR)
+                continue;
+            int target = finalTarget(term.target);
+            if (target != term.target && target != block->id)
+            {
+                term.target = target;
+                changed = true;
+            }
+            if (term.op == IR_BR)
+            {
+                target = finalTarget(term.falseTarget);
+                if (target != term.falseTarget && target != block->id)
+                {
+                    term.falseTarget = target;
+                    changed = true;
+                }
+            }
+        }
+        if (changed)
+            func.computeCFG();
+        return changed;
+    }
+
+    bool removeUnreachable()
+    {
+        std::vector<bool> reachable(func.blocks.size(), false);
+        std::vector<int> worklist = {0};
+        reachable[0] = true;
+        while (!worklist.empty())
+        {
+            int block = worklist.back();
+            worklist.pop_back();
+            for (auto succ = func.blocks[block].succs.begin(); succ != func.blocks[block].succs.end(); succ++)
+            {
+                if (!reachable[*succ])
+                {
+                    reachable[*succ] = true;
+                    worklist.push_back(*succ);
+                }
+            }
+        }
+
+        std::vector<bool> removed(func.blocks.size(), false);
+        bool changed = false;
+        for (size_t i = 0; i < func.blocks.size(); i++)
+        {
+            if (!reachable[i])
+            {
+                removed[i] = true;
+                removedInstNum += func.blocks[i].insts.size();
+                changed = true;
+            }
+        }
+        if (changed)
+            compact(removed);
+        return changed;
+    }
+
+    // 块i以jmp跳到下一个块，并且是下一个块唯一的前驱时，把下一个块接到块i的末尾
+    // 只合并相邻的块，不改变其余基本块的先后顺序，不会多出跳转
+    bool mergeBlocks()
+    {
+        std::vector<bool> removed(func.blocks.size(), false);
+        bool changed = false;
+        for (size_t i = 0; i < func.blocks.size(); i++)
+        {
+            if (removed[i])
+                continue;
+            IRBlock &block = func.blocks[i];
+            for (size_t next = i + 1; next < func.blocks.size(); next++)
+            {
+                IRBlock &succ = func.blocks[next];
+                if (block.insts.back().op != IR_JMP || block.insts.back().target != (int)next ||
+                    succ.preds.size() != 1)
+                    break;
+                block.insts.pop_back();
+                block.insts.insert(block.insts.end(), succ.insts.begin(), succ.insts.end());
+                block.succs = succ.succs;
+                for (auto s = succ.succs.begin(); s != succ.succs.end(); s++)
+                {
+                    for (auto p = func.blocks[*s].preds.begin(); p != func.blocks[*s].preds.end(); p++)
+                    {
+                        if (*p == (int)next)
+                            *p = i;
+                    }
+                }
+                removed[next] = true;
+                changed = true;
+            }
+        }
+        if (changed)
+            compact(removed);
+        return changed;
+    }
+
+    // 删除标记的基本块，其余的块重新编号
+    void compact(const std::vector<bool> &removed)
+    {
+        std::vector<int> newId(func.blocks.size(), -1);
+        std::vector<IRBlock> blocks;
+        blocks.reserve(func.blocks.size());
+        for (size_t i = 0; i < func.blocks.size(); i++)
+        {
+            if (removed[i])
+            {
+                removedBlockNum++;
+                continue;
+            }
+            newId[i] = blocks.size();
+            blocks.push_back(std::move(func.blocks[i]));
+            blocks.back().id = newId[i];
+        }
+        for (auto block = blocks.begin(); block != blocks.end(); block++)
+        {
+            IRInst &term = block->insts.back();
+            if (term.op == IR_JMP || term.op == IR_BR)
+                term.target = newId[term.target];
+            if (term.op == IR_BR)
+                term.falseTarget = newId[term.falseTarget];
+        }
+        func.blocks = std::move(blocks);
+        func.computeCFG();
+    }
+
+    bool removeDeadStores()
+    {
+        Liveness liveness(func);
+        int removed = 0;
+        for (size_t i = 0; i < func.blocks.size(); i++)
+        {
+            std::vector<bool> live = liveness.liveOut[i];
+            std::vector<IRInst> &insts = func.blocks[i].insts;
+            std::vector<IRInst> kept;
+            kept.reserve(insts.size());
+            for (auto inst = insts.rbegin(); inst != insts.rend(); inst++)
+            {
+                if (inst->isPure() &&
+                    (!live[inst->dst.value] || (inst->op == IR_COPY && inst->a == inst->dst)))
+                {
+                    removed++;
+                    continue;
+                }
+                if (inst->hasDst())
+                    live[inst->dst.value] = false;
+                forEachUse(*inst, [&](int v)
+                           { live[v] = true; });
+                kept.push_back(*inst);
+            }
+            if (kept.size() != insts.size())
+                insts.assign(std::make_move_iterator(kept.rbegin()), std::make_move_iterator(kept.rend()));
+        }
+        removedInstNum += removed;
+        return removed > 0;
+    }
+};
+
+#endif
@@ -0,0 +1,286 @@
+#ifndef __ELFWRITER_H__
+#define __ELFWRITER_H__
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "AsmWriter.h"
+#include "MachineCode.h"
+
+// ELF可重定位目标文件（.o）的输出，内容与汇编代码经as汇编的结果相同：
+// .text中依次是各个函数的机器码，.data中是format_str，对format_str、printf和其他函数的引用都是重定位
+// 32位时用.rel.text，加数写在指令中；x86-64时用.rela.text，加数在重定位项中
+class ElfWriter
+{
+public:
+    explicit ElfWriter(Target target) : x86_64(target == TARGET_X86_64) {}
+
+    // 函数按添加的顺序排列；只有main是全局符号，与汇编代码中的.global main一致
+    void addFunction(const MachineCode &code)
+    {
+        int offset = text.size();
+        bool global = code.name == "main";
+        functions.push_back(Function{code.name, offset, (int)code.bytes.size(), global});
+        text += code.bytes;
+        for (auto it = code.relocs.begin(); it != code.relocs.end(); it++)
+        {
+            relocs.push_back(*it);
+            relocs.back().offset += offset;
+            if (!x86_64 && it->kind != RELOC_ABS32)
+            {
+                // 相对于下一条指令：S + A - P中A为-4
+                for (int i = 0; i < 4; i++)
+                    text[relocs.back().offset + i] = (char)(i == 0 ? 0xfc : 0xff);
+            }
+        }
+    }
+
+    // 把整个目标文件写到out
+    void write(AsmWriter &out) const
+    {
+        // 符号表中局部符号在前：format_str、main以外的函数，然后是main和未定义的printf
+        std::string strtab(1, '\0');
+        std::vector<ElfSymbol> symbols(1, ElfSymbol{0, 0, 0, 0, 0});
+        std::map<std::string, int> symbolIndex;
+        addSymbol(strtab, symbols, symbolIndex, "format_str", 0, 4, STB_LOCAL, STT_OBJECT, SECTION_DATA);
+        int firstGlobal = 0;
+        for (int global = 0; global < 2; global++)
+        {
+            firstGlobal = symbols.size();
+            for (auto it = functions.begin(); it != functions.end(); it++)
+            {
+                if (it->global == (global == 1))
+                    addSymbol(strtab, symbols, symbolIndex, it->name, it->offset, it->size,
+                              it->global ? STB_GLOBAL : STB_LOCAL, STT_FUNC, SECTION_TEXT);
+            }
+        }
+        for (auto it = relocs.begin(); it != relocs.end(); it++)
+        {
+            if (symbolIndex.count(it->symbol) == 0)
+                addSymbol(strtab, symbols, symbolIndex, it->symbol, 0, 0, STB_GLOBAL, STT_NOTYPE, 0);
+        }
+
+        std::string symtab;
+        for (auto it = symbols.begin(); it != symbols.end(); it++)
+        {
+            putSymbol(symtab, *it);
+        }
+        std::string rel;
+        for (auto it = relocs.begin(); it != relocs.end(); it++)
+        {
+            putReloc(rel, *it, symbolIndex.at(it->symbol));
+        }
+
+        std::string shstrtab(1, '\0');
+        std::vector<Section> sections(SECTION_NUM);
+        sections[SECTION_TEXT] = Section{name(shstrtab, ".text"), SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0, 0, 16, 0, &text};
+        static const std::string data("%d\n", 4);
+        sections[SECTION_DATA] = Section{name(shstrtab, ".data"), SHT_PROGBITS, SHF_ALLOC | SHF_WRITE, 0, 0, 4, 0, &data};
+        sections[SECTION_REL] = Section{name(shstrtab, x86_64 ? ".rela.text" : ".rel.text"), x86_64 ? SHT_RELA : SHT_REL,
+                                        SHF_INFO_LINK, SECTION_SYMTAB, SECTION_TEXT, wordBytes(), relocBytes(), &rel};
+        sections[SECTION_SYMTAB] = Section{name(shstrtab, ".symtab"), SHT_SYMTAB, 0, SECTION_STRTAB, firstGlobal,
+                                           wordBytes(), symbolBytes(), &symtab};
+        sections[SECTION_STRTAB] = Section{name(shstrtab, ".strtab"), SHT_STRTAB, 0, 0, 0, 1, 0, &strtab};
+        // 不需要可执行的栈
+        static const std::string empty;
+        sections[SECTION_NOTE] = Section{name(shstrtab, ".note.GNU-stack"), SHT_PROGBITS, 0, 0, 0, 1, 0, &empty};
+        sections[SECTION_SHSTRTAB] = Section{name(shstrtab, ".shstrtab"), SHT_STRTAB, 0, 0, 0, 1, 0, &shstrtab};
+
+        // ELF头，之后依次是各个节的内容，最后是节头表
+        std::string file(x86_64 ? 64 : 52, '\0');
+        std::vector<int> offsets(SECTION_NUM, 0);
+        for (int i = 1; i < SECTION_NUM; i++)
+        {
+            align(file, sections[i].align);
+            offsets[i] = file.size();
+            file += *sections[i].content;
+        }
+        align(file, wordBytes());
+        int sectionHeaderOffset = file.size();
+        file.append(sectionHeaderBytes(), '\0'); // 第0个节头全为0
+        for (int i = 1; i < SECTION_NUM; i++)
+        {
+            putSectionHeader(file, sections[i], offsets[i]);
+        }
+
+        std::string header("\x7f" "ELF", 4);
+        put(header, x86_64 ? 2 : 1, 1);  // ELFCLASS64或ELFCLASS32
+        put(header, 1, 1);               // 小端
+        put(header, 1, 1);               // EV_CURRENT
+        header.append(9, '\0');
+        put(header, 1, 2);               // ET_REL
+        put(header, x86_64 ? 62 : 3, 2); // EM_X86_64或EM_386
+        put(header, 1, 4);               // EV_CURRENT
+        put(header, 0, wordBytes());     // 入口
+        put(header, 0, wordBytes());     // 程序头表
+        put(header, sectionHeaderOffset, wordBytes());
+        put(header, 0, 4);               // 标志
+        put(header, x86_64 ? 64 : 52, 2);
+        put(header, 0, 2);               // 程序头的大小
+        put(header, 0, 2);               // 程序头的个数
+        put(header, sectionHeaderBytes(), 2);
+        put(header, SECTION_NUM, 2);
+        put(header, SECTION_SHSTRTAB, 2);
+        file.replace(0, header.size(), header);
+        out << file;
+    }
+
+private:
+    // 节的编号
+    enum
+    {
+        SECTION_NULL,
+        SECTION_TEXT,
+        SECTION_DATA,
+        SECTION_REL,
+        SECTION_SYMTAB,
+        SECTION_STRTAB,
+        SECTION_NOTE,
+        SECTION_SHSTRTAB,
+        SECTION_NUM,
+    };
+
+    enum
+    {
+        SHT_PROGBITS = 1,
+        SHT_SYMTAB = 2,
+        SHT_STRTAB = 3,
+        SHT_RELA = 4,
+        SHT_REL = 9,
+        SHF_WRITE = 0x1,
+        SHF_ALLOC = 0x2,
+        SHF_EXECINSTR = 0x4,
+        SHF_INFO_LINK = 0x40,
+        STB_LOCAL = 0,
+        STB_GLOBAL = 1,
+        STT_NOTYPE = 0,
+        STT_OBJECT = 1,
+        STT_FUNC = 2,
+    };
+
+    struct Function
+    {
+        std::string name;
+        int offset; // 在.text中的偏移
+        int size;
+        bool global;
+    };
+
+    struct ElfSymbol
+    {
+        int name; // 在.strtab中的偏移
+        int value;
+        int size;
+        int info;
+        int section;
+    };
+
+    struct Section
+    {
+        int name; // 在.shstrtab中的偏移
+        int type;
+        int flags;
+        int link;
+        int info;
+        int align;
+        int entrySize;
+        const std::string *content;
+    };
+
+    bool x86_64;
+    std::string text;
+    std::vector<Function> functions;
+    std::vector<Relocation> relocs; // offset是在.text中的偏移
+
+    int wordBytes() const { return x86_64 ? 8 : 4; }
+    int symbolBytes() const { return x86_64 ? 24 : 16; }
+    int relocBytes() const { return x86_64 ? 24 : 8; }
+    int sectionHeaderBytes() const { return x86_64 ? 64 : 40; }
+
+    // 小端的bytes字节整数
+    static void put(std::string &out, int64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; i++)
+            out.push_back((char)((uint64_t)value >> (8 * i) & 0xff));
+    }
+
+    static void align(std::string &out, int alignment)
+    {
+        while (out.size() % alignment != 0)
+            out.push_back('\0');
+    }
+
+    static int name(std::string &strtab, const std::string &text)
+    {
+        int offset = strtab.size();
+        strtab += text;
+        strtab.push_back('\0');
+        return offset;
+    }
+
+    static void addSymbol(std::string &strtab, std::vector<ElfSymbol> &symbols, std::map<std::string, int> &symbolIndex,
+                          const std::string &symbol, int value, int size, int bind, int type, int section)
+    {
+        symbolIndex[symbol] = symbols.size();
+        symbols.push_back(ElfSymbol{name(strtab, symbol), value, size, bind << 4 | type, section});
+    }
+
+    void putSymbol(std::string &out, const ElfSymbol &symbol) const
+    {
+        put(out, symbol.name, 4);
+        if (x86_64)
+        {
+            put(out, symbol.info, 1);
+            put(out, 0, 1);
+            put(out, symbol.section, 2);
+            put(out, symbol.value, 8);
+            put(out, symbol.size, 8);
+        }
+        else
+        {
+            put(out, symbol.value, 4);
+            put(out, symbol.size, 4);
+            put(out, symbol.info, 1);
+            put(out, 0, 1);
+            put(out, symbol.section, 2);
+        }
+    }
+
+    void putReloc(std::string &out, const Relocation &reloc, int symbol) const
+    {
+        if (x86_64)
+        {
+            // R_X86_64_32、R_X86_64_PC32、R_X86_64_PLT32
+            int type = reloc.kind == RELOC_ABS32 ? 10 : reloc.kind == RELOC_PC32 ? 2 : 4;
+            put(out, reloc.offset, 8);
+            put(out, (int64_t)symbol << 32 | type, 8);
+            put(out, reloc.kind == RELOC_ABS32 ? 0 : -4, 8);
+        }
+        else
+        {
+            // R_386_32、R_386_PC32
+            int type = reloc.kind == RELOC_ABS32 ? 1 : 2;
+            put(out, reloc.offset, 4);
+            put(out, symbol << 8 | type, 4);
+        }
+    }
+
+    void putSectionHeader(std::string &out, const Section &section, int offset) const
+    {
+        put(out, section.name, 4);
+        put(out, section.type, 4);
+        put(out, section.flags, wordBytes());
+        put(out, 0, wordBytes()); // 地址
+        put(out, offset, wordBytes());
+        put(out, section.content->size(), wordBytes());
+        put(out, section.link, 4);
+        put(out, section.info, 4);
+        put(out, section.align, wordBytes());
+        put(out, section.entrySize, wordBytes());
+    }
+};
+
+#endif
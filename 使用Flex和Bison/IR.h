@@ -0,0 +1,303 @@
+#ifndef __IR_H__
+#define __IR_H__
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "Symbol.h"
+
+// 三地址码形式的中间表示，位于语法树和x86代码生成之间
+// 语言中只有int一种值类型，所有虚拟寄存器都是i32；函数的返回值可以是i32或void
+// 虚拟寄存器不是SSA形式，可以被多次赋值；前slotNum个虚拟寄存器就是名字解析得到的变量
+
+enum IRType
+{
+    IR_VOID,
+    IR_I32,
+};
+
+// 指令的操作数：虚拟寄存器或立即数
+struct IRValue
+{
+    enum Kind
+    {
+        NONE,
+        VREG,
+        IMM,
+    };
+
+    Kind kind = NONE;
+    int value = 0; // 虚拟寄存器的编号或立即数的值
+
+    static IRValue vreg(int no)
+    {
+        IRValue v;
+        v.kind = VREG;
+        v.value = no;
+        return v;
+    }
+
+    static IRValue imm(int value)
+    {
+        IRValue v;
+        v.kind = IMM;
+        v.value = value;
+        return v;
+    }
+
+    bool isNone() const { return kind == NONE; }
+    bool isVReg() const { return kind == VREG; }
+    bool isImm() const { return kind == IMM; }
+
+    bool operator==(const IRValue &other) const
+    {
+        return kind == other.kind && value == other.value;
+    }
+
+    bool operator!=(const IRValue &other) const
+    {
+        return !(*this == other);
+    }
+};
+
+enum IROpcode
+{
+    IR_COPY, // dst = a
+    IR_ADD,  // dst = a + b
+    IR_SUB,  // dst = a - b
+    IR_MUL,  // dst = a * b
+    IR_DIV,  // dst = a / b
+    IR_MOD,  // dst = a % b
+    IR_AND,  // dst = a & b
+    IR_OR,   // dst = a | b
+    IR_XOR,  // dst = a ^ b
+    IR_SHL,  // dst = a << b
+    IR_SAR,  // dst = a >> b，算术右移
+    IR_NEG,  // dst = -a
+    IR_NOT,  // dst = ~a
+    IR_CMP,  // dst = (a cmp b) ? 1 : 0
+    IR_CALL, // dst = callee(args...)
+    // 以下是终结指令，只能出现在基本块的末尾
+    IR_JMP,  // goto target
+    IR_BR,   // if (a cmp b) goto target else goto falseTarget
+    IR_RET,  // return a，a为空时没有返回值
+    IR_TAILCALL, // return callee(args...)，本函数的栈帧让给被调用的函数，由它直接返回到本函数的调用者
+};
+
+struct IRInst
+{
+    IROpcode op;
+    IRValue dst;
+    IRValue a;
+    IRValue b;
+    COperator cmp = CEQ;           // IR_CMP和IR_BR的比较运算，CEQ到CGE之一
+    int target = -1;               // IR_JMP和IR_BR条件成立时的目标基本块
+    int falseTarget = -1;          // IR_BR条件不成立时的目标基本块
+    const Symbol *callee = nullptr; // IR_CALL和IR_TAILCALL调用的函数
+    std::vector<IRValue> args;     // IR_CALL和IR_TAILCALL的实参，按源代码中的顺序
+
+    bool isTerminator() const
+    {
+        return op == IR_JMP || op == IR_BR || op == IR_RET || op == IR_TAILCALL;
+    }
+
+    // 指令是否把结果写到dst
+    bool hasDst() const
+    {
+        return op <= IR_CALL;
+    }
+
+    // 指令除了写dst之外没有别的作用：结果用不到时可以删除，也可以移到别处计算
+    // 调用可能输出；除数不是非零常量的除法可能触发除零异常(INT_MIN / -1也会)
+    bool isPure() const
+    {
+        if (!hasDst() || op == IR_CALL)
+            return false;
+        if (op == IR_DIV || op == IR_MOD)
+            return b.isImm() && b.value != 0 && b.value != -1;
+        return true;
+    }
+};
+
+// 基本块：只在开头进入、只在末尾离开的指令序列，最后一条指令是终结指令
+struct IRBlock
+{
+    int id;                    // 等于它在IRFunction::blocks中的下标，也就是它在输出中的位置
+    std::string label;         // 标签名（不含函数的前缀），入口块是entry
+    std::vector<IRInst> insts;
+    std::vector<int> preds;    // 前驱，由computeCFG计算
+    std::vector<int> succs;    // 后继，由computeCFG计算
+    int depth = 1;             // 输出汇编代码时的缩进层数
+    int loopDepth = 0;         // 所在循环的嵌套层数，用于估计溢出代价
+
+    bool isTerminated() const
+    {
+        return !insts.empty() && insts.back().isTerminator();
+    }
+};
+
+// 目标平台上通过栈传递的参数个数：32位时全部，x86-64时第6个之后的
+inline int stackArgNum(int argNum)
+{
+    if (compilerOptions.target == TARGET_X86_64)
+        return argNum > 6 ? argNum - 6 : 0;
+    return argNum;
+}
+
+// 一个函数的中间表示，blocks[0]是入口块，blocks的顺序就是输出的顺序
+struct IRFunction
+{
+    const Symbol *symbol = nullptr;
+    IRType returnType = IR_I32;
+    int paramNum = 0; // 参数依次是前paramNum个虚拟寄存器
+    int slotNum = 0;  // 参数和局部变量占用前slotNum个虚拟寄存器
+    int vregNum = 0;
+    std::vector<IRBlock> blocks;
+
+    IRValue newVReg()
+    {
+        return IRValue::vreg(vregNum++);
+    }
+
+    // 根据每个基本块的终结指令重新计算前驱和后继
+    void computeCFG()
+    {
+        for (auto it = blocks.begin(); it != blocks.end(); it++)
+        {
+            it->preds.clear();
+            it->succs.clear();
+        }
+        for (auto it = blocks.begin(); it != blocks.end(); it++)
+        {
+            if (!it->isTerminated())
+                continue;
+            const IRInst &term = it->insts.back();
+            if (term.op == IR_JMP || term.op == IR_BR)
+                addEdge(*it, term.target);
+            if (term.op == IR_BR && term.falseTarget != term.target)
+                addEdge(*it, term.falseTarget);
+        }
+    }
+
+    // 输出可读的文本形式，用于调试
+    void dump(std::ostream &out) const
+    {
+        out << "define " << (returnType == IR_VOID ? "void" : "i32") << " @" << symbol->name << "(";
+        for (int i = 0; i < paramNum; i++)
+        {
+            out << (i == 0 ? "" : ", ") << "i32 %" << i;
+        }
+        out << ") {  ; " << slotNum << " variables, " << vregNum << " vregs\n";
+        for (auto it = blocks.begin(); it != blocks.end(); it++)
+        {
+            out << it->label << ":";
+            if (!it->preds.empty())
+            {
+                out << "  ; preds:";
+                for (auto p = it->preds.begin(); p != it->preds.end(); p++)
+                    out << (p == it->preds.begin() ? " " : ", ") << blocks[*p].label;
+            }
+            out << "\n";
+            for (auto inst = it->insts.begin(); inst != it->insts.end(); inst++)
+            {
+                out << "    ";
+                dumpInst(out, *inst);
+                out << "\n";
+            }
+        }
+        out << "}\n";
+    }
+
+    void dumpInst(std::ostream &out, const IRInst &inst) const
+    {
+        static const char *names[] = {"copy", "add", "sub", "mul", "div", "mod", "and", "or", "xor", "shl", "sar",
+                                      "neg", "not", "cmp", "call", "jmp", "br", "ret", "tailcall"};
+        if (inst.hasDst())
+        {
+            dumpValue(out, inst.dst);
+            out << " = ";
+        }
+        out << names[inst.op];
+        switch (inst.op)
+        {
+        case IR_CMP:
+        case IR_BR:
+            out << " " << cmpName(inst.cmp) << " ";
+            dumpValue(out, inst.a);
+            out << ", ";
+            dumpValue(out, inst.b);
+            if (inst.op == IR_BR)
+                out << ", " << blocks[inst.target].label << ", " << blocks[inst.falseTarget].label;
+            break;
+        case IR_CALL:
+        case IR_TAILCALL:
+            out << " @" << inst.callee->name << "(";
+            for (size_t i = 0; i < inst.args.size(); i++)
+            {
+                out << (i == 0 ? "" : ", ");
+                dumpValue(out, inst.args[i]);
+            }
+            out << ")";
+            break;
+        case IR_JMP:
+            out << " " << blocks[inst.target].label;
+            break;
+        default:
+            if (!inst.a.isNone())
+            {
+                out << " ";
+                dumpValue(out, inst.a);
+            }
+            if (!inst.b.isNone())
+            {
+                out << ", ";
+                dumpValue(out, inst.b);
+            }
+            break;
+        }
+    }
+
+    static void dumpValue(std::ostream &out, const IRValue &v)
+    {
+        if (v.isVReg())
+            out << "%" << v.value;
+        else if (v.isImm())
+            out << v.value;
+        else
+            out << "_";
+    }
+
+    static const char *cmpName(COperator cmp)
+    {
+        switch (cmp)
+        {
+        case CEQ:
+            return "eq";
+        case CNE:
+            return "ne";
+        case CLT:
+            return "lt";
+        case CLE:
+            return "le";
+        case CGT:
+            return "gt";
+        case CGE:
+            return "ge";
+        default:
+            return "?";
+        }
+    }
+
+private:
+    void addEdge(IRBlock &from, int to)
+    {
+        if (to < 0 || to >= (int)blocks.size())
+            return; // 由验证器报告
+        from.succs.push_back(to);
+        blocks[to].preds.push_back(from.id);
+    }
+};
+
+#endif
@@ -0,0 +1,167 @@
+#ifndef __IRANALYSIS_H__
+#define __IRANALYSIS_H__
+
+#include <utility>
+#include <vector>
+
+#include "IR.h"
+
+// 各个优化共用的IR分析，结果只对计算时的IR有效，改动IR之后需要重新计算
+
+// 对指令读取的每个虚拟寄存器调用f
+template <typename F>
+void forEachUse(const IRInst &inst, F f)
+{
+    if (inst.a.isVReg())
+        f(inst.a.value);
+    if (inst.b.isVReg())
+        f(inst.b.value);
+    for (auto arg = inst.args.begin(); arg != inst.args.end(); arg++)
+    {
+        if (arg->isVReg())
+            f(arg->value);
+    }
+}
+
+// 活跃变量分析：liveIn[b][v]表示进入基本块b时虚拟寄存器v的值之后还会被读取
+struct Liveness
+{
+    std::vector<std::vector<bool>> liveIn;
+    std::vector<std::vector<bool>> liveOut;
+
+    explicit Liveness(const IRFunction &func)
+    {
+        size_t blockNum = func.blocks.size();
+        std::vector<std::vector<bool>> def(blockNum, std::vector<bool>(func.vregNum, false));
+        liveIn.assign(blockNum, std::vector<bool>(func.vregNum, false));
+        liveOut.assign(blockNum, std::vector<bool>(func.vregNum, false));
+        for (size_t i = 0; i < blockNum; i++)
+        {
+            for (auto inst = func.blocks[i].insts.begin(); inst != func.blocks[i].insts.end(); inst++)
+            {
+                forEachUse(*inst, [&](int v)
+                           { if (!def[i][v]) liveIn[i][v] = true; });
+                if (inst->hasDst())
+                    def[i][inst->dst.value] = true;
+            }
+        }
+
+        // liveIn = use ∪ (liveOut - def)，倒序遍历收敛得快
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t i = blockNum; i-- > 0;)
+            {
+                std::vector<bool> &out = liveOut[i];
+                for (auto succ = func.blocks[i].succs.begin(); succ != func.blocks[i].succs.end(); succ++)
+                {
+                    for (int v = 0; v < func.vregNum; v++)
+                    {
+                        if (liveIn[*succ][v] && !out[v])
+                        {
+                            out[v] = true;
+                            if (!def[i][v])
+                                liveIn[i][v] = true;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+        }
+    }
+};
+
+// 支配关系，使用Cooper、Harvey和Kennedy的迭代算法
+// 从入口到基本块b的每条路径都经过a时，称a支配b
+struct Dominators
+{
+    std::vector<int> idom; // 直接支配者，入口块是它自己，不可达的块是-1
+    std::vector<int> rpo;  // 可达基本块的逆后序
+
+    explicit Dominators(const IRFunction &func)
+    {
+        size_t blockNum = func.blocks.size();
+        order.assign(blockNum, -1);
+        std::vector<bool> visited(blockNum, false);
+        postorder(func, 0, visited);
+        rpo.assign(post.rbegin(), post.rend());
+        for (size_t i = 0; i < rpo.size(); i++)
+            order[rpo[i]] = i;
+
+        idom.assign(blockNum, -1);
+        idom[0] = 0;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t i = 1; i < rpo.size(); i++)
+            {
+                int block = rpo[i];
+                int newIdom = -1;
+                for (auto pred = func.blocks[block].preds.begin(); pred != func.blocks[block].preds.end(); pred++)
+                {
+                    if (idom[*pred] == -1)
+                        continue;
+                    newIdom = newIdom == -1 ? *pred : intersect(*pred, newIdom);
+                }
+                if (newIdom != idom[block])
+                {
+                    idom[block] = newIdom;
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    bool dominates(int a, int b) const
+    {
+        if (idom[b] == -1)
+            return false;
+        while (b != a && b != 0)
+            b = idom[b];
+        return b == a;
+    }
+
+private:
+    std::vector<int> order; // 基本块在逆后序中的位置
+    std::vector<int> post;
+
+    void postorder(const IRFunction &func, int root, std::vector<bool> &visited)
+    {
+        // 显式的栈，避免很长的函数递归过深
+        std::vector<std::pair<int, size_t>> stack = {std::make_pair(root, (size_t)0)};
+        visited[root] = true;
+        while (!stack.empty())
+        {
+            int block = stack.back().first;
+            size_t &next = stack.back().second;
+            if (next < func.blocks[block].succs.size())
+            {
+                int succ = func.blocks[block].succs[next++];
+                if (!visited[succ])
+                {
+                    visited[succ] = true;
+                    stack.push_back(std::make_pair(succ, (size_t)0));
+                }
+                continue;
+            }
+            post.push_back(block);
+            stack.pop_back();
+        }
+    }
+
+    int intersect(int a, int b) const
+    {
+        while (a != b)
+        {
+            while (order[a] > order[b])
+                a = idom[a];
+            while (order[b] > order[a])
+                b = idom[b];
+        }
+        return a;
+    }
+};
+
+#endif
@@ -0,0 +1,449 @@
+#ifndef __IRGENERATOR_H__
+#define __IRGENERATOR_H__
+
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ASTNodes.h"
+#include "IR.h"
+
+// 把名字解析和常量折叠之后的函数定义翻译为IR
+// 控制流语句和短路求值被拆成基本块，条件表达式直接翻译为带两个目标的条件跳转
+class IRGenerator
+{
+public:
+    IRFunction generate(const NFunctionDefine *funcDef)
+    {
+        IRFunction result;
+        func = &result;
+        result.symbol = funcDef->id->symbol;
+        result.returnType = funcDef->type == CType::VOID ? IR_VOID : IR_I32;
+        // 名字解析最先声明参数，第i个参数就是第i个变量
+        result.paramNum = funcDef->arguments->variableDeclarationList.size();
+        result.slotNum = funcDef->slotNum;
+        result.vregNum = funcDef->slotNum;
+
+        labelNo = 0;
+        depth = 1;
+        loopDepth = 0;
+        loops.clear();
+        layout.clear();
+        place(newBlock("entry"));
+
+        genStatements(funcDef->block);
+        if (!func->blocks[current].isTerminated())
+        {
+            IRInst ret;
+            ret.op = IR_RET;
+            emit(ret);
+        }
+
+        finish();
+        func = nullptr;
+        return result;
+    }
+
+private:
+    IRFunction *func = nullptr;
+    int current = 0;          // 正在追加指令的基本块
+    std::vector<int> layout;  // 基本块放置的顺序，也就是输出的顺序
+    int labelNo = 0;
+    int depth = 1;
+    int loopDepth = 0;
+    std::vector<std::pair<int, int>> loops; // 所在循环continue和break的目标
+
+    // 新建一个基本块，暂不放置
+    int newBlock(const std::string &label)
+    {
+        IRBlock block;
+        block.id = func->blocks.size();
+        block.label = label;
+        func->blocks.push_back(block);
+        return block.id;
+    }
+
+    // 把基本块放在当前位置，之后的指令追加到其中；上一个基本块没有终结时顺序执行到这里
+    void place(int block)
+    {
+        if (!layout.empty() && !func->blocks[current].isTerminated())
+            emitJump(block);
+        current = block;
+        layout.push_back(block);
+        func->blocks[block].depth = depth;
+        func->blocks[block].loopDepth = loopDepth;
+    }
+
+    void emit(const IRInst &inst)
+    {
+        // return、break、continue之后的语句不可达，放到一个新的基本块中
+        if (func->blocks[current].isTerminated())
+            place(newBlock("bb_" + std::to_string(++labelNo)));
+        func->blocks[current].insts.push_back(inst);
+    }
+
+    void emit(IROpcode op, const IRValue &dst, const IRValue &a, const IRValue &b = IRValue())
+    {
+        IRInst inst;
+        inst.op = op;
+        inst.dst = dst;
+        inst.a = a;
+        inst.b = b;
+        emit(inst);
+    }
+
+    void emitJump(int target)
+    {
+        IRInst inst;
+        inst.op = IR_JMP;
+        inst.target = target;
+        emit(inst);
+    }
+
+    void emitBranch(COperator cmp, const IRValue &a, const IRValue &b, int trueTarget, int falseTarget)
+    {
+        IRInst inst;
+        inst.op = IR_BR;
+        inst.cmp = cmp;
+        inst.a = a;
+        inst.b = b;
+        inst.target = trueTarget;
+        inst.falseTarget = falseTarget;
+        emit(inst);
+    }
+
+    // 按放置的顺序重新排列基本块，使编号就是输出的位置，再计算控制流图
+    void finish()
+    {
+        std::vector<int> position(func->blocks.size(), -1);
+        for (size_t i = 0; i < layout.size(); i++)
+            position[layout[i]] = i;
+        std::vector<IRBlock> blocks;
+        blocks.reserve(layout.size());
+        for (size_t i = 0; i < layout.size(); i++)
+        {
+            blocks.push_back(std::move(func->blocks[layout[i]]));
+            blocks.back().id = i;
+            for (auto it = blocks.back().insts.begin(); it != blocks.back().insts.end(); it++)
+            {
+                if (it->target >= 0)
+                    it->target = position[it->target];
+                if (it->falseTarget >= 0)
+                    it->falseTarget = position[it->falseTarget];
+            }
+        }
+        func->blocks.swap(blocks);
+        func->computeCFG();
+    }
+
+    void genStatements(const NBlock *block)
+    {
+        for (auto it = block->statements.begin(); it != block->statements.end(); it++)
+            genStatement(*it);
+    }
+
+    void genStatement(const NStatement *statement)
+    {
+        if (auto n = dynamic_cast<const NExpressionStatement *>(statement))
+        {
+            genValue(n->expression);
+        }
+        else if (auto n = dynamic_cast<const NVariableDeclaration *>(statement))
+        {
+            for (auto it = n->variableDeclarationList.begin(); it != n->variableDeclarationList.end(); it++)
+            {
+                if ((*it)->assignmentExpr != nullptr)
+                    genValueInto((*it)->assignmentExpr, IRValue::vreg((*it)->id->slot));
+            }
+        }
+        else if (auto n = dynamic_cast<const NReturnStatement *>(statement))
+        {
+            emit(IR_RET, IRValue(), genValue(n->expression));
+        }
+        else if (auto n = dynamic_cast<const NIfStatement *>(statement))
+        {
+            genIf(n);
+        }
+        else if (auto n = dynamic_cast<const NWhileStatement *>(statement))
+        {
+            genWhile(n);
+        }
+        else if (dynamic_cast<const NContinueStatement *>(statement) != nullptr)
+        {
+            emitJump(loops.back().first);
+        }
+        else if (dynamic_cast<const NBreakStatement *>(statement) != nullptr)
+        {
+            emitJump(loops.back().second);
+        }
+        else if (auto n = dynamic_cast<const NBlock *>(statement))
+        {
+            genStatements(n);
+        }
+    }
+
+    void genIf(const NIfStatement *n)
+    {
+        std::string no = std::to_string(++labelNo);
+        int conBlock = newBlock("ifcon_" + no);
+        int ifBlock = newBlock("if_" + no);
+        int elseBlock = n->elseBlock != nullptr ? newBlock("else_" + no) : -1;
+        int endBlock = newBlock("ifend_" + no);
+
+        depth++;
+        place(conBlock);
+        genCondition(n->condition, ifBlock, elseBlock != -1 ? elseBlock : endBlock);
+        place(ifBlock);
+        genStatements(n->ifBlock);
+        if (elseBlock != -1)
+        {
+            emitJump(endBlock);
+            place(elseBlock);
+            genStatements(n->elseBlock);
+        }
+        depth--;
+        place(endBlock);
+    }
+
+    void genWhile(const NWhileStatement *n)
+    {
+        // 条件放在循环体之后，每次迭代只执行一条条件跳转
+        std::string no = std::to_string(++labelNo);
+        int bodyBlock = newBlock("while_" + no);
+        int conBlock = newBlock("whilecon_" + no);
+        int endBlock = newBlock("whileend_" + no);
+
+        emitJump(conBlock);
+        depth++;
+        loopDepth++;
+        loops.push_back(std::make_pair(conBlock, endBlock));
+        place(bodyBlock);
+        genStatements(n->block);
+        place(conBlock);
+        genCondition(n->condition, bodyBlock, endBlock);
+        loops.pop_back();
+        loopDepth--;
+        depth--;
+        place(endBlock);
+    }
+
+    // 计算表达式的值，返回存放结果的虚拟寄存器或立即数
+    IRValue genValue(const NExpression *expr)
+    {
+        if (auto n = dynamic_cast<const NInteger *>(expr))
+            return IRValue::imm(n->value);
+        if (auto n = dynamic_cast<const NIdentifier *>(expr))
+            return IRValue::vreg(n->slot);
+        if (auto n = dynamic_cast<const NAssignment *>(expr))
+        {
+            IRValue variable = IRValue::vreg(n->left->slot);
+            genValueInto(n->right, variable);
+            return variable;
+        }
+        if (auto n = dynamic_cast<const NMethodCall *>(expr))
+            return genCall(n);
+        IRValue dest = func->newVReg();
+        genValueInto(expr, dest);
+        return dest;
+    }
+
+    // 计算表达式的值并写入dest，运算的结果直接写到目的变量中，不经过临时寄存器
+    void genValueInto(const NExpression *expr, const IRValue &dest)
+    {
+        if (auto n = dynamic_cast<const NBinaryOperatorExpression *>(expr))
+        {
+            genBinary(n, dest);
+        }
+        else if (auto n = dynamic_cast<const NUnaryOperatorExpression *>(expr))
+        {
+            genUnary(n, dest);
+        }
+        else
+        {
+            IRValue value = genValue(expr);
+            if (value != dest)
+                emit(IR_COPY, dest, value);
+        }
+    }
+
+    // 先求值的操作数引用了变量，而后求值的部分会给变量赋值时，先复制一份
+    IRValue protect(const IRValue &value, bool laterAssigns)
+    {
+        if (!value.isVReg() || !laterAssigns)
+            return value;
+        IRValue copy = func->newVReg();
+        emit(IR_COPY, copy, value);
+        return copy;
+    }
+
+    IRValue genCall(const NMethodCall *n)
+    {
+        const ExpressionList &arguments = *n->arguments;
+        // assigned[i]表示前i个实参中有没有赋值
+        std::vector<bool> assigned(arguments.size() + 1, false);
+        for (size_t i = 0; i < arguments.size(); i++)
+            assigned[i + 1] = assigned[i] || arguments[i]->hasAssignment();
+
+        IRInst inst;
+        inst.op = IR_CALL;
+        inst.callee = n->id->symbol;
+        inst.args.resize(arguments.size());
+        // 实参从右向左求值
+        for (size_t i = arguments.size(); i-- > 0;)
+            inst.args[i] = protect(genValue(arguments[i]), assigned[i]);
+        inst.dst = func->newVReg();
+        emit(inst);
+        return inst.dst;
+    }
+
+    static bool isComparison(COperator op)
+    {
+        return op == CEQ || op == CNE || op == CLT || op == CLE || op == CGT || op == CGE;
+    }
+
+    void genBinary(const NBinaryOperatorExpression *n, const IRValue &dest)
+    {
+        if (n->op == COperator::AND || n->op == COperator::OR)
+        {
+            // 短路求值，通过条件跳转得到0或1
+            std::string no = std::to_string(++labelNo);
+            int trueBlock = newBlock("true_" + no);
+            int falseBlock = newBlock("false_" + no);
+            int endBlock = newBlock("condend_" + no);
+            genCondition(n, trueBlock, falseBlock);
+            place(trueBlock);
+            emit(IR_COPY, dest, IRValue::imm(1));
+            emitJump(endBlock);
+            place(falseBlock);
+            emit(IR_COPY, dest, IRValue::imm(0));
+            place(endBlock);
+            return;
+        }
+
+        IRValue l = protect(genValue(n->left), n->right->hasAssignment());
+        IRValue r = genValue(n->right);
+        if (isComparison(n->op))
+        {
+            IRInst inst;
+            inst.op = IR_CMP;
+            inst.cmp = n->op;
+            inst.dst = dest;
+            inst.a = l;
+            inst.b = r;
+            emit(inst);
+            return;
+        }
+
+        IROpcode op;
+        switch (n->op)
+        {
+        case COperator::PLUS:
+            op = IR_ADD;
+            break;
+        case COperator::MINUS:
+            op = IR_SUB;
+            break;
+        case COperator::MUL:
+            op = IR_MUL;
+            break;
+        case COperator::DIV:
+            op = IR_DIV;
+            break;
+        case COperator::MOD:
+            op = IR_MOD;
+            break;
+        case COperator::BITAND:
+            op = IR_AND;
+            break;
+        case COperator::BITOR:
+            op = IR_OR;
+            break;
+        case COperator::BITXOR:
+            op = IR_XOR;
+            break;
+        case COperator::LSHIFT:
+            op = IR_SHL;
+            break;
+        case COperator::RSHIFT:
+            op = IR_SAR;
+            break;
+        default:
+            std::cerr << "[ERROR] Unknown operator: " << n->op << std::endl;
+            return;
+        }
+        emit(op, dest, l, r);
+    }
+
+    void genUnary(const NUnaryOperatorExpression *n, const IRValue &dest)
+    {
+        IRValue value = genValue(n->operand);
+        switch (n->op)
+        {
+        case COperator::NEG:
+            emit(IR_NEG, dest, value);
+            break;
+        case COperator::BITNOT:
+            emit(IR_NOT, dest, value);
+            break;
+        case COperator::NOT:
+        {
+            IRInst inst;
+            inst.op = IR_CMP;
+            inst.cmp = CEQ;
+            inst.dst = dest;
+            inst.a = value;
+            inst.b = IRValue::imm(0);
+            emit(inst);
+            break;
+        }
+        default:
+            std::cerr << "[ERROR] Unknown operator: " << n->op << std::endl;
+            break;
+        }
+    }
+
+    // 表达式的值非0时跳转到trueBlock，否则跳转到falseBlock
+    void genCondition(const NExpression *expr, int trueBlock, int falseBlock)
+    {
+        if (auto n = dynamic_cast<const NInteger *>(expr))
+        {
+            emitJump(n->value != 0 ? trueBlock : falseBlock);
+            return;
+        }
+        if (auto n = dynamic_cast<const NUnaryOperatorExpression *>(expr))
+        {
+            if (n->op == COperator::NOT)
+            {
+                genCondition(n->operand, falseBlock, trueBlock);
+                return;
+            }
+        }
+        if (auto n = dynamic_cast<const NBinaryOperatorExpression *>(expr))
+        {
+            if (n->op == COperator::AND || n->op == COperator::OR)
+            {
+                // 左操作数已经能决定结果时不再对右操作数求值
+                int rightBlock = newBlock("cond_" + std::to_string(++labelNo));
+                if (n->op == COperator::AND)
+                    genCondition(n->left, rightBlock, falseBlock);
+                else
+                    genCondition(n->left, trueBlock, rightBlock);
+                place(rightBlock);
+                genCondition(n->right, trueBlock, falseBlock);
+                return;
+            }
+            if (isComparison(n->op))
+            {
+                // 比较运算直接翻译为条件跳转，不生成0或1
+                IRValue l = protect(genValue(n->left), n->right->hasAssignment());
+                IRValue r = genValue(n->right);
+                emitBranch(n->op, l, r, trueBlock, falseBlock);
+                return;
+            }
+        }
+        emitBranch(CNE, genValue(expr), IRValue::imm(0), trueBlock, falseBlock);
+    }
+};
+
+#endif
@@ -0,0 +1,168 @@
+#ifndef __IRVERIFIER_H__
+#define __IRVERIFIER_H__
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+
+#include "IR.h"
+
+// 检查IR是否满足后续各个阶段依赖的约定，生成IR和每个优化之后都可以调用
+class IRVerifier
+{
+public:
+    int errorNum = 0;
+
+    IRVerifier(const IRFunction &func, std::ostream &err) : func(func), err(err) {}
+
+    // 没有发现错误时返回true
+    bool verify()
+    {
+        errorNum = 0;
+        if (func.blocks.empty())
+        {
+            error(-1, "function has no blocks");
+            return false;
+        }
+        if (!func.blocks[0].preds.empty())
+            error(0, "entry block has predecessors");
+        if (func.paramNum > func.slotNum || func.slotNum > func.vregNum)
+            error(-1, "inconsistent parameter, variable and vreg counts");
+
+        for (size_t i = 0; i < func.blocks.size(); i++)
+        {
+            const IRBlock &block = func.blocks[i];
+            if (block.id != (int)i)
+                error(i, "block id does not match its position");
+            if (!block.isTerminated())
+                error(i, "block does not end with a terminator");
+            for (size_t k = 0; k < block.insts.size(); k++)
+            {
+                const IRInst &inst = block.insts[k];
+                if (inst.isTerminator() && k + 1 != block.insts.size())
+                    error(i, "terminator in the middle of a block");
+                verifyInst(i, inst);
+            }
+            verifyEdges(i);
+        }
+        return errorNum == 0;
+    }
+
+private:
+    const IRFunction &func;
+    std::ostream &err;
+
+    void error(int block, const std::string &message)
+    {
+        // 只报告前几个错误，通常第一个就能说明问题
+        if (errorNum++ >= 8)
+            return;
+        err << "[ERROR] IR verification failed in " << func.symbol->name;
+        if (block >= 0)
+            err << ", block " << func.blocks[block].label;
+        err << ": " << message << std::endl;
+    }
+
+    bool validValue(const IRValue &v) const
+    {
+        return v.isImm() || (v.isVReg() && v.value >= 0 && v.value < func.vregNum);
+    }
+
+    bool validTarget(int target) const
+    {
+        return target >= 0 && target < (int)func.blocks.size();
+    }
+
+    void verifyInst(int block, const IRInst &inst)
+    {
+        if (inst.hasDst() && !inst.dst.isVReg())
+            error(block, "instruction result is not a vreg");
+        if (inst.hasDst() && !validValue(inst.dst))
+            error(block, "instruction result is out of range");
+        switch (inst.op)
+        {
+        case IR_COPY:
+        case IR_NEG:
+        case IR_NOT:
+            if (!validValue(inst.a) || !inst.b.isNone())
+                error(block, "bad operands for unary instruction");
+            break;
+        case IR_CMP:
+        case IR_BR:
+            if (inst.cmp < CEQ || inst.cmp > CGE)
+                error(block, "comparison operator expected");
+            // fall through
+        case IR_ADD:
+        case IR_SUB:
+        case IR_MUL:
+        case IR_DIV:
+        case IR_MOD:
+        case IR_AND:
+        case IR_OR:
+        case IR_XOR:
+        case IR_SHL:
+        case IR_SAR:
+            if (!validValue(inst.a) || !validValue(inst.b))
+                error(block, "bad operands for binary instruction");
+            break;
+        case IR_CALL:
+        case IR_TAILCALL:
+            if (inst.callee == nullptr)
+                error(block, "call without callee");
+            for (auto it = inst.args.begin(); it != inst.args.end(); it++)
+            {
+                if (!validValue(*it))
+                    error(block, "bad call argument");
+            }
+            break;
+        case IR_JMP:
+            break;
+        case IR_RET:
+            if (!inst.a.isNone() && !validValue(inst.a))
+                error(block, "bad return value");
+            break;
+        }
+
+        if (inst.op == IR_JMP || inst.op == IR_BR)
+        {
+            if (!validTarget(inst.target) || (inst.op == IR_BR && !validTarget(inst.falseTarget)))
+                error(block, "branch target out of range");
+            else if (inst.target == 0 || (inst.op == IR_BR && inst.falseTarget == 0))
+                error(block, "branch to the entry block");
+        }
+    }
+
+    // 前驱和后继必须与终结指令一致，即改动控制流之后调用过computeCFG
+    void verifyEdges(int block)
+    {
+        const IRBlock &b = func.blocks[block];
+        std::vector<int> expected;
+        if (b.isTerminated())
+        {
+            const IRInst &term = b.insts.back();
+            if ((term.op == IR_JMP || term.op == IR_BR) && validTarget(term.target))
+                expected.push_back(term.target);
+            if (term.op == IR_BR && term.falseTarget != term.target && validTarget(term.falseTarget))
+                expected.push_back(term.falseTarget);
+        }
+        if (expected != b.succs)
+            error(block, "successor list is out of date");
+        for (auto it = b.succs.begin(); it != b.succs.end(); it++)
+        {
+            if (!validTarget(*it))
+                continue;
+            const std::vector<int> &preds = func.blocks[*it].preds;
+            if (std::count(preds.begin(), preds.end(), block) != 1)
+                error(block, "predecessor list of " + func.blocks[*it].label + " is out of date");
+        }
+        for (auto it = b.preds.begin(); it != b.preds.end(); it++)
+        {
+            if (!validTarget(*it))
+                error(block, "predecessor out of range");
+            else if (std::count(func.blocks[*it].succs.begin(), func.blocks[*it].succs.end(), block) != 1)
+                error(block, "predecessor " + func.blocks[*it].label + " does not branch here");
+        }
+    }
+};
+
+#endif
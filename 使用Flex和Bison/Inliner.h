@@ -0,0 +1,231 @@
+#ifndef __INLINER_H__
+#define __INLINER_H__
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "IR.h"
+
+// 内联：把短小的非递归函数的函数体复制到调用处，省掉压栈、call、序言和尾声
+// 代价是被调用函数的指令条数（不含jmp），不超过阈值才内联；调用在循环中时阈值更高
+// 内联进来的函数体中的调用也会被考虑，调用者增长到一定大小后停止
+// 被调用函数的IR只读，可以被同时处理其他函数的线程共享
+class Inliner
+{
+public:
+    static const int CALLEE_COST_LIMIT = 10;      // 循环外的调用
+    static const int LOOP_CALLEE_COST_LIMIT = 30; // 循环中的调用
+    static const int CALLER_SIZE_LIMIT = 400;     // 调用者增长到这么多条指令后不再内联
+
+    int inlinedNum = 0;   // 内联的调用个数
+    int inlinedCost = 0;  // 复制进来的指令条数
+
+    // functions：已经生成IR的所有自定义函数，按函数的符号查找
+    Inliner(IRFunction &func, const std::unordered_map<const Symbol *, const IRFunction *> &functions)
+        : func(func), functions(functions) {}
+
+    void run()
+    {
+        int size = cost(func);
+        // 内联后block之后紧接着就是被内联的函数体，其中的调用接着被处理
+        for (size_t b = 0; b < func.blocks.size(); b++)
+        {
+            for (size_t i = 0; i < func.blocks[b].insts.size(); i++)
+            {
+                const IRInst &inst = func.blocks[b].insts[i];
+                if (inst.op != IR_CALL && inst.op != IR_TAILCALL)
+                    continue;
+                const IRFunction *callee = inlineCandidate(inst, func.blocks[b].loopDepth);
+                if (callee == nullptr || size + cost(*callee) > CALLER_SIZE_LIMIT)
+                    continue;
+                size += cost(*callee);
+                inlinedCost += cost(*callee);
+                inlinedNum++;
+                inlineCall(b, i, *callee);
+                break;
+            }
+        }
+        func.computeCFG();
+    }
+
+    static int cost(const IRFunction &f)
+    {
+        int n = 0;
+        for (auto block = f.blocks.begin(); block != f.blocks.end(); block++)
+        {
+            for (auto inst = block->insts.begin(); inst != block->insts.end(); inst++)
+            {
+                if (inst->op != IR_JMP)
+                    n++;
+            }
+        }
+        return n;
+    }
+
+    // 函数体中调用了自己就是递归的（尾递归已经变成了循环，这里只剩下非尾递归）
+    static bool isRecursive(const IRFunction &f)
+    {
+        for (auto block = f.blocks.begin(); block != f.blocks.end(); block++)
+        {
+            for (auto inst = block->insts.begin(); inst != block->insts.end(); inst++)
+            {
+                if ((inst->op == IR_CALL || inst->op == IR_TAILCALL) && inst->callee == f.symbol)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    IRFunction &func;
+    const std::unordered_map<const Symbol *, const IRFunction *> &functions;
+
+    const IRFunction *inlineCandidate(const IRInst &call, int loopDepth) const
+    {
+        if (call.callee == func.symbol)
+            return nullptr;
+        auto it = functions.find(call.callee);
+        if (it == functions.end() || (int)call.args.size() != it->second->paramNum)
+            return nullptr;
+        const IRFunction *callee = it->second;
+        int limit = loopDepth > 0 ? LOOP_CALLEE_COST_LIMIT : CALLEE_COST_LIMIT;
+        if (cost(*callee) > limit || isRecursive(*callee))
+            return nullptr;
+        return callee;
+    }
+
+    // 把blocks[b].insts[i]处的调用替换为callee的函数体：
+    // b在调用处截断，给参数赋值后顺序执行到复制进来的入口块；调用之后的指令移到新的基本块ret中，
+    // 函数体中的ret给调用的结果赋值后跳到那里
+    // 内联的是尾调用时没有之后的指令，函数体中的ret就是调用者的ret
+    void inlineCall(int b, int i, const IRFunction &callee)
+    {
+        std::string prefix = "inl" + std::to_string(inlinedNum) + "_" + callee.symbol->name + "_";
+        int vregBase = func.vregNum;
+        func.vregNum += callee.vregNum;
+        int blockBase = b + 1;                             // 复制进来的入口块的编号
+        int cont = blockBase + (int)callee.blocks.size(); // 调用之后的指令所在的块
+
+        IRInst call = func.blocks[b].insts[i];
+        bool tail = call.op == IR_TAILCALL;
+        IRBlock after;
+        after.label = prefix + "ret";
+        after.depth = func.blocks[b].depth;
+        after.loopDepth = func.blocks[b].loopDepth;
+        after.insts.assign(func.blocks[b].insts.begin() + i + 1, func.blocks[b].insts.end());
+        func.blocks[b].insts.resize(i);
+
+        // 调用者原有的、在调用处之后的基本块编号都后移
+        int shift = (int)callee.blocks.size() + (tail ? 0 : 1);
+        for (auto block = func.blocks.begin(); block != func.blocks.end(); block++)
+        {
+            if (block->id > b)
+                block->id += shift;
+            renumber(block->insts.empty() ? nullptr : &block->insts.back(), b, shift);
+        }
+        if (!tail)
+            renumber(&after.insts.back(), b, shift);
+
+        for (int p = 0; p < callee.paramNum; p++)
+        {
+            func.blocks[b].insts.push_back(makeCopy(IRValue::vreg(vregBase + p), call.args[p]));
+        }
+        func.blocks[b].insts.push_back(makeJump(blockBase));
+
+        std::vector<IRBlock> body;
+        body.reserve(callee.blocks.size() + 1);
+        for (auto block = callee.blocks.begin(); block != callee.blocks.end(); block++)
+        {
+            IRBlock copy;
+            copy.id = blockBase + block->id;
+            copy.label = prefix + block->label;
+            copy.depth = block->depth + func.blocks[b].depth - 1;
+            copy.loopDepth = block->loopDepth + func.blocks[b].loopDepth;
+            for (auto inst = block->insts.begin(); inst != block->insts.end(); inst++)
+            {
+                IRInst x = *inst;
+                x.dst = remap(x.dst, vregBase);
+                x.a = remap(x.a, vregBase);
+                x.b = remap(x.b, vregBase);
+                for (auto arg = x.args.begin(); arg != x.args.end(); arg++)
+                    *arg = remap(*arg, vregBase);
+                if (x.op == IR_JMP || x.op == IR_BR)
+                {
+                    x.target += blockBase;
+                    x.falseTarget += x.op == IR_BR ? blockBase : 0;
+                }
+                if (x.op == IR_RET && !tail)
+                {
+                    if (!x.a.isNone())
+                        copy.insts.push_back(makeCopy(call.dst, x.a));
+                    copy.insts.push_back(makeJump(cont));
+                    continue;
+                }
+                if (x.op == IR_TAILCALL && (!tail || stackArgNum(x.args.size()) > stackArgNum(func.paramNum)))
+                {
+                    // 在调用者中不是尾调用了，或者调用者的参数所在的栈单元放不下实参，改回普通调用
+                    IRValue result = tail ? func.newVReg() : call.dst;
+                    x.op = IR_CALL;
+                    x.dst = result;
+                    copy.insts.push_back(x);
+                    if (tail)
+                    {
+                        IRInst ret;
+                        ret.op = IR_RET;
+                        ret.a = result;
+                        copy.insts.push_back(ret);
+                    }
+                    else
+                    {
+                        copy.insts.push_back(makeJump(cont));
+                    }
+                    continue;
+                }
+                copy.insts.push_back(x);
+            }
+            body.push_back(std::move(copy));
+        }
+        if (!tail)
+        {
+            after.id = cont;
+            body.push_back(std::move(after));
+        }
+        func.blocks.insert(func.blocks.begin() + blockBase, std::make_move_iterator(body.begin()),
+                           std::make_move_iterator(body.end()));
+    }
+
+    static void renumber(IRInst *term, int b, int shift)
+    {
+        if (term == nullptr || (term->op != IR_JMP && term->op != IR_BR))
+            return;
+        if (term->target > b)
+            term->target += shift;
+        if (term->op == IR_BR && term->falseTarget > b)
+            term->falseTarget += shift;
+    }
+
+    static IRValue remap(const IRValue &v, int vregBase)
+    {
+        return v.isVReg() ? IRValue::vreg(v.value + vregBase) : v;
+    }
+
+    static IRInst makeCopy(const IRValue &dst, const IRValue &src)
+    {
+        IRInst inst;
+        inst.op = IR_COPY;
+        inst.dst = dst;
+        inst.a = src;
+        return inst;
+    }
+
+    static IRInst makeJump(int target)
+    {
+        IRInst inst;
+        inst.op = IR_JMP;
+        inst.target = target;
+        return inst;
+    }
+};
+
+#endif
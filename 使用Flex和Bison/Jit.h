@@ -0,0 +1,142 @@
+#ifndef __JIT_H__
+#define __JIT_H__
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <sys/mman.h>
+
+#include "global.h"
+#include "MachineCode.h"
+
+// 即时编译：把各个函数的机器码装入可执行的内存，在编译器的进程中直接调用main
+// 内存中依次是各个函数、转到printInt的跳板和format_str，重定位在这里直接填写，不经过汇编器和链接器
+// 生成的代码要在编译器所在的平台上执行，目标平台由hostTarget决定
+class JitProgram
+{
+public:
+    JitProgram() = default;
+    JitProgram(const JitProgram &) = delete;
+    JitProgram &operator=(const JitProgram &) = delete;
+
+    ~JitProgram()
+    {
+        if (memory != nullptr)
+            munmap(memory, size);
+    }
+
+    // 编译器所在的平台，不是x86时返回false
+    static bool hostTarget(Target &target)
+    {
+#if defined(__x86_64__)
+        target = TARGET_X86_64;
+        return true;
+#elif defined(__i386__)
+        target = TARGET_I386;
+        return true;
+#else
+        (void)target;
+        return false;
+#endif
+    }
+
+    // 装入按源代码顺序排列的各个函数，失败时把原因写到diagnostics并返回false
+    bool load(const std::vector<MachineCode> &functions, std::ostream &diagnostics)
+    {
+        std::string image;
+        std::map<std::string, size_t> symbols;
+        for (auto it = functions.begin(); it != functions.end(); it++)
+        {
+            symbols[it->name] = image.size();
+            image += it->bytes;
+        }
+        if (symbols.count("main") == 0)
+        {
+            diagnostics << "没有main函数" << std::endl;
+            return false;
+        }
+        symbols["printf"] = image.size();
+        image.append(STUB_BYTES, '\0');
+        symbols["format_str"] = image.size();
+        image.append("%d\n", 4);
+
+        size = image.size();
+        memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+        {
+            memory = nullptr;
+            diagnostics << "无法分配可执行内存" << std::endl;
+            return false;
+        }
+        char *base = static_cast<char *>(memory);
+        std::memcpy(base, image.data(), size);
+
+        size_t offset = 0;
+        for (auto it = functions.begin(); it != functions.end(); it++)
+        {
+            for (auto reloc = it->relocs.begin(); reloc != it->relocs.end(); reloc++)
+            {
+                char *field = base + offset + reloc->offset;
+                uintptr_t target = reinterpret_cast<uintptr_t>(base + symbols.at(reloc->symbol));
+                // 都在同一块内存中，相对偏移一定在32位以内
+                uint32_t value = reloc->kind == RELOC_ABS32 ? (uint32_t)target
+                                                            : (uint32_t)(target - reinterpret_cast<uintptr_t>(field + 4));
+                std::memcpy(field, &value, 4);
+            }
+            offset += it->bytes.size();
+        }
+        writeStub(base + symbols["printf"]);
+
+        // 写完之后去掉写权限，内存不同时可写可执行
+        if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+        {
+            diagnostics << "无法分配可执行内存" << std::endl;
+            return false;
+        }
+        entry = reinterpret_cast<int (*)()>(base + symbols["main"]);
+        return true;
+    }
+
+    // 调用main，返回它的返回值，也就是程序的退出码
+    int run() const
+    {
+        int result = entry();
+        std::fflush(stdout);
+        return result;
+    }
+
+private:
+    static const int STUB_BYTES = 14;
+
+    void *memory = nullptr;
+    size_t size = 0;
+    int (*entry)() = nullptr;
+
+    // 生成的代码中println_int是printf(format_str, a)，经跳板转到这里，输出与链接到C库时相同
+    static int printInt(const char *format, int value)
+    {
+        return std::printf(format, value);
+    }
+
+    // 宿主函数可能离这块内存很远，x86-64下用jmp [rip+0]跳到紧接着的64位地址
+    static void writeStub(char *stub)
+    {
+        uintptr_t host = reinterpret_cast<uintptr_t>(&printInt);
+#if defined(__x86_64__)
+        static const unsigned char jmp[] = {0xFF, 0x25, 0, 0, 0, 0};
+        std::memcpy(stub, jmp, sizeof(jmp));
+        std::memcpy(stub + sizeof(jmp), &host, 8);
+#else
+        uint32_t rel = (uint32_t)(host - reinterpret_cast<uintptr_t>(stub + 5));
+        stub[0] = (char)0xE9;
+        std::memcpy(stub + 1, &rel, 4);
+#endif
+    }
+};
+
+#endif
@@ -0,0 +1,221 @@
+#ifndef __LOOPINVARIANTCODEMOTION_H__
+#define __LOOPINVARIANTCODEMOTION_H__
+
+#include <algorithm>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "IR.h"
+#include "IRAnalysis.h"
+
+// 循环不变量外提：把循环中每次迭代结果都相同的指令移到循环前的preheader中，只计算一次
+// 例如while (i < n * n - 1)中的n * n - 1
+// 指令可以外提的条件：
+// 1. 没有副作用(IRInst::isPure)，调用可能输出，总是留在原处
+// 2. 读取的虚拟寄存器在循环中没有被赋值，或者是已经外提的指令的结果
+//    语言中没有全局变量和指针，调用不会修改调用者的局部变量
+// 3. 结果在循环中只被赋值这一次，并且进入循环时它原来的值不会再被读取
+// 内层循环先处理，外提到内层preheader中的指令还可以继续移出外层循环
+class LoopInvariantCodeMotion
+{
+public:
+    int hoistedNum = 0; // 外提的指令条数
+    int loopNum = 0;    // 有指令外提的循环个数
+
+    LoopInvariantCodeMotion(IRFunction &func) : func(func) {}
+
+    void run()
+    {
+        func.computeCFG();
+        std::set<std::string> done; // 处理过的循环，用头结点的标签区分；插入preheader后基本块的编号会变
+        while (true)
+        {
+            std::vector<Loop> loops = findLoops();
+            auto loop = loops.begin();
+            while (loop != loops.end() && done.count(func.blocks[loop->header].label) != 0)
+                loop++;
+            if (loop == loops.end())
+                break;
+            done.insert(func.blocks[loop->header].label);
+            if (hoist(*loop))
+                loopNum++;
+        }
+    }
+
+private:
+    struct Loop
+    {
+        int header;
+        std::vector<bool> body; // body[b]表示基本块b在循环中，包括头结点
+        int size;
+    };
+
+    IRFunction &func;
+
+    // 找出所有自然循环：头结点支配回边的起点；头结点相同的回边属于同一个循环
+    std::vector<Loop> findLoops() const
+    {
+        Dominators dom(func);
+        std::vector<Loop> loops;
+        for (auto block = func.blocks.begin(); block != func.blocks.end(); block++)
+        {
+            for (auto succ = block->succs.begin(); succ != block->succs.end(); succ++)
+            {
+                if (!dom.dominates(*succ, block->id))
+                    continue;
+                auto loop = std::find_if(loops.begin(), loops.end(), [&](const Loop &l)
+                                         { return l.header == *succ; });
+                if (loop == loops.end())
+                {
+                    loops.push_back(Loop{*succ, std::vector<bool>(func.blocks.size(), false), 1});
+                    loop = loops.end() - 1;
+                    loop->body[*succ] = true;
+                }
+                // 从回边的起点沿前驱反向走到头结点
+                std::vector<int> worklist = {block->id};
+                while (!worklist.empty())
+                {
+                    int b = worklist.back();
+                    worklist.pop_back();
+                    if (loop->body[b])
+                        continue;
+                    loop->body[b] = true;
+                    loop->size++;
+                    worklist.insert(worklist.end(), func.blocks[b].preds.begin(), func.blocks[b].preds.end());
+                }
+            }
+        }
+        // 内层循环比外层循环小
+        std::stable_sort(loops.begin(), loops.end(), [](const Loop &l, const Loop &r)
+                         { return l.size < r.size; });
+        return loops;
+    }
+
+    bool hoist(const Loop &loop)
+    {
+        Liveness liveness(func);
+        std::vector<int> defNum(func.vregNum, 0);
+        for (size_t b = 0; b < func.blocks.size(); b++)
+        {
+            if (!loop.body[b])
+                continue;
+            for (auto inst = func.blocks[b].insts.begin(); inst != func.blocks[b].insts.end(); inst++)
+            {
+                if (inst->hasDst())
+                    defNum[inst->dst.value]++;
+            }
+        }
+
+        // 反复扫描，直到找不到新的不变量；invariants按外提后的执行顺序排列
+        std::vector<bool> hoisted(func.vregNum, false);
+        std::vector<std::vector<bool>> moved(func.blocks.size());
+        std::vector<IRInst> invariants;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (size_t b = 0; b < func.blocks.size(); b++)
+            {
+                if (!loop.body[b])
+                    continue;
+                const std::vector<IRInst> &insts = func.blocks[b].insts;
+                moved[b].resize(insts.size(), false);
+                for (size_t i = 0; i < insts.size(); i++)
+                {
+                    const IRInst &inst = insts[i];
+                    if (moved[b][i] || !inst.isPure() || defNum[inst.dst.value] != 1 ||
+                        liveness.liveIn[loop.header][inst.dst.value])
+                        continue;
+                    bool invariant = true;
+                    forEachUse(inst, [&](int v)
+                               { if (defNum[v] != 0 && !hoisted[v]) invariant = false; });
+                    if (!invariant)
+                        continue;
+                    moved[b][i] = true;
+                    hoisted[inst.dst.value] = true;
+                    invariants.push_back(inst);
+                    changed = true;
+                }
+            }
+        }
+        if (invariants.empty())
+            return false;
+
+        for (size_t b = 0; b < func.blocks.size(); b++)
+        {
+            if (moved[b].empty())
+                continue;
+            std::vector<IRInst> kept;
+            for (size_t i = 0; i < func.blocks[b].insts.size(); i++)
+            {
+                if (!moved[b][i])
+                    kept.push_back(std::move(func.blocks[b].insts[i]));
+            }
+            func.blocks[b].insts = std::move(kept);
+        }
+
+        std::vector<IRInst> &insts = func.blocks[preheader(loop)].insts;
+        insts.insert(insts.end() - 1, invariants.begin(), invariants.end());
+        hoistedNum += invariants.size();
+        func.computeCFG();
+        return true;
+    }
+
+    // 循环外唯一的前驱只跳到头结点时就用它作为preheader，否则新建一个
+    int preheader(const Loop &loop)
+    {
+        int header = loop.header;
+        std::vector<int> outside;
+        for (auto pred = func.blocks[header].preds.begin(); pred != func.blocks[header].preds.end(); pred++)
+        {
+            if (!loop.body[*pred])
+                outside.push_back(*pred);
+        }
+        if (outside.size() == 1 && func.blocks[outside[0]].insts.back().op == IR_JMP)
+            return outside[0];
+
+        // 放在循环的第一个基本块之前，循环外的代码顺序执行到它，不会在循环中多出跳转
+        int first = std::find(loop.body.begin(), loop.body.end(), true) - loop.body.begin();
+        IRBlock block;
+        block.label = "pre_" + func.blocks[header].label;
+        block.depth = std::max(func.blocks[header].depth - 1, 1);
+        block.loopDepth = std::max(func.blocks[header].loopDepth - 1, 0);
+        IRInst jump;
+        jump.op = IR_JMP;
+        jump.target = header;
+        block.insts.push_back(jump);
+        for (auto pred = outside.begin(); pred != outside.end(); pred++)
+        {
+            IRInst &term = func.blocks[*pred].insts.back();
+            if (term.target == header)
+                term.target = -1;
+            if (term.op == IR_BR && term.falseTarget == header)
+                term.falseTarget = -1;
+        }
+
+        func.blocks.insert(func.blocks.begin() + first, block);
+        for (size_t b = 0; b < func.blocks.size(); b++)
+        {
+            func.blocks[b].id = b;
+            IRInst &term = func.blocks[b].insts.back();
+            if (term.op != IR_JMP && term.op != IR_BR)
+                continue;
+            term.target = renumber(term.target, first);
+            if (term.op == IR_BR)
+                term.falseTarget = renumber(term.falseTarget, first);
+        }
+        func.computeCFG();
+        return first;
+    }
+
+    // 插入新块之后的编号；-1表示跳到新的preheader
+    static int renumber(int target, int inserted)
+    {
+        if (target == -1)
+            return inserted;
+        return target >= inserted ? target + 1 : target;
+    }
+};
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef __MACHINECODE_H__
+#define __MACHINECODE_H__
+
+#include <string>
+#include <vector>
+
+// 重定位的类型，由ElfWriter换成目标平台的重定位类型，--jit时由JitProgram直接填写
+enum RelocKind
+{
+    RELOC_ABS32, // 符号的绝对地址，32位时的push offset format_str
+    RELOC_PC32,  // 相对于下一条指令的偏移，32位时的call和jmp，x86-64下的lea reg, [rip+format_str]
+    RELOC_PLT32, // x86-64下的call和jmp，外部函数经过PLT
+};
+
+// 机器码中需要链接器填写的4字节
+struct Relocation
+{
+    int offset; // 在函数代码中的偏移
+    std::string symbol;
+    RelocKind kind;
+};
+
+// 一个函数的机器码
+struct MachineCode
+{
+    std::string name; // 函数的符号名
+    std::string bytes;
+    std::vector<Relocation> relocs;
+};
+
+#endif
@@ -0,0 +1,169 @@
+#ifndef __NAMERESOLVER_H__
+#define __NAMERESOLVER_H__
+
+#include <ostream>
+#include <unordered_set>
+
+#include "ASTNodes.h"
+#include "CompilationContext.h"
+
+// 名字解析：在生成代码之前把每个标识符绑定到所在函数中的变量编号
+// 每个语句块是一层作用域，内层的声明遮蔽外层的同名变量；未定义和重复定义的名字在这里报错
+class NameResolver
+{
+public:
+    int errorNum = 0; // 报告的错误个数
+    int boundNum = 0; // 绑定的变量引用个数
+
+    NameResolver(CompilationContext &context) : context(context) {}
+
+    void run(NBlock *program)
+    {
+        // 函数可以在定义之前调用，先收集所有函数名
+        functions.clear();
+        functions.insert(context.symbols.printSymbol);
+        for (auto it = program->statements.begin(); it != program->statements.end(); it++)
+        {
+            auto func = dynamic_cast<NFunctionDefine *>(*it);
+            if (func != nullptr && !functions.insert(func->id->symbol).second)
+                error(func->id, "redefinition of function");
+        }
+
+        for (auto it = program->statements.begin(); it != program->statements.end(); it++)
+        {
+            auto func = dynamic_cast<NFunctionDefine *>(*it);
+            if (func != nullptr)
+                resolveFunction(func);
+        }
+    }
+
+private:
+    CompilationContext &context;
+    IdentifierTable identifierTable;
+    std::unordered_set<const Symbol *> functions;
+    int slotNum = 0; // 当前函数中已经分配的变量编号
+
+    void error(const NIdentifier *id, const char *message)
+    {
+        context.diagnostics << "[ERROR] line " << id->line << ": " << message << " '" << id->symbol->name << "'" << std::endl;
+        errorNum++;
+    }
+
+    void declare(NIdentifier *id)
+    {
+        id->slot = slotNum;
+        if (identifierTable.add(id->symbol, slotNum) == -1)
+            error(id, "redefinition of variable");
+        slotNum++;
+    }
+
+    void resolveFunction(NFunctionDefine *func)
+    {
+        identifierTable.clear();
+        slotNum = 0;
+
+        // 参数和函数体最外层的声明在同一个作用域中
+        identifierTable.enterScope();
+        for (auto it = func->arguments->variableDeclarationList.begin(); it != func->arguments->variableDeclarationList.end(); it++)
+            declare((*it)->id);
+        resolveStatements(func->block);
+        identifierTable.exitScope();
+
+        func->slotNum = slotNum;
+    }
+
+    void resolveBlock(NBlock *block)
+    {
+        if (block == nullptr)
+            return;
+        identifierTable.enterScope();
+        resolveStatements(block);
+        identifierTable.exitScope();
+    }
+
+    void resolveStatements(NBlock *block)
+    {
+        for (auto it = block->statements.begin(); it != block->statements.end(); it++)
+            resolveStatement(*it);
+    }
+
+    void resolveStatement(NStatement *statement)
+    {
+        if (auto n = dynamic_cast<NExpressionStatement *>(statement))
+        {
+            resolveExpression(n->expression);
+        }
+        else if (auto n = dynamic_cast<NVariableDeclaration *>(statement))
+        {
+            // 与C语言一致，变量的作用域从声明符之后开始，初始化表达式中已经可见
+            for (auto it = n->variableDeclarationList.begin(); it != n->variableDeclarationList.end(); it++)
+            {
+                declare((*it)->id);
+                if ((*it)->assignmentExpr != nullptr)
+                    resolveExpression((*it)->assignmentExpr);
+            }
+        }
+        else if (auto n = dynamic_cast<NReturnStatement *>(statement))
+        {
+            resolveExpression(n->expression);
+        }
+        else if (auto n = dynamic_cast<NIfStatement *>(statement))
+        {
+            resolveExpression(n->condition);
+            resolveBlock(n->ifBlock);
+            resolveBlock(n->elseBlock);
+        }
+        else if (auto n = dynamic_cast<NWhileStatement *>(statement))
+        {
+            resolveExpression(n->condition);
+            resolveBlock(n->block);
+        }
+        else if (auto n = dynamic_cast<NFunctionDefine *>(statement))
+        {
+            error(n->id, "nested function definition");
+        }
+    }
+
+    void resolveExpression(NExpression *expr)
+    {
+        if (auto n = dynamic_cast<NIdentifier *>(expr))
+        {
+            resolveVariable(n);
+        }
+        else if (auto n = dynamic_cast<NAssignment *>(expr))
+        {
+            resolveVariable(n->left);
+            resolveExpression(n->right);
+        }
+        else if (auto n = dynamic_cast<NMethodCall *>(expr))
+        {
+            if (functions.find(n->id->symbol) == functions.end())
+                error(n->id, "undefined function");
+            for (auto it = n->arguments->begin(); it != n->arguments->end(); it++)
+                resolveExpression(*it);
+        }
+        else if (auto n = dynamic_cast<NUnaryOperatorExpression *>(expr))
+        {
+            resolveExpression(n->operand);
+        }
+        else if (auto n = dynamic_cast<NBinaryOperatorExpression *>(expr))
+        {
+            resolveExpression(n->left);
+            resolveExpression(n->right);
+        }
+    }
+
+    void resolveVariable(NIdentifier *id)
+    {
+        ssize_t index = identifierTable.find(id->symbol);
+        if (index == -1)
+        {
+            error(id, "undefined variable");
+            return;
+        }
+        id->slot = identifierTable.get(index).slot;
+        boundNum++;
+    }
+};
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef __PEEPHOLE_H__
+#define __PEEPHOLE_H__
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AsmCode.h"
+
+// 窥孔优化：在寄存器分配之后的指令序列上滑动窗口，按规则表改写，直到不再变化
+class PeepholeOptimizer
+{
+public:
+    typedef bool (PeepholeOptimizer::*Rule)(size_t i);
+
+    // 规则表，每条规则检查从下标i开始的窗口，改写成功时返回true
+    struct RuleItem
+    {
+        const char *name;
+        Rule rule;
+    };
+
+    PeepholeOptimizer(AsmFunction &func) : func(func), insts(func.insts) {}
+
+    // 运行到不动点，返回删除的指令条数（不含标签）
+    int optimize()
+    {
+        size_t ruleNum;
+        const RuleItem *table = rules(ruleNum);
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            countLabelRefs();
+            for (size_t i = 0; i < insts.size(); i++)
+            {
+                for (size_t k = 0; k < ruleNum && i < insts.size(); k++)
+                {
+                    if ((this->*table[k].rule)(i))
+                    {
+                        changed = true;
+                    }
+                }
+            }
+        }
+        return removed;
+    }
+
+private:
+    AsmFunction &func;
+    std::vector<MInst> &insts;
+    std::map<std::string, int> labelRefs; // 每个标签被跳转指令引用的次数
+    int removed = 0;
+
+    static const RuleItem *rules(size_t &num)
+    {
+        static const RuleItem table[] = {
+            {"self-move", &PeepholeOptimizer::removeSelfMove},
+            {"identity-arithmetic", &PeepholeOptimizer::removeIdentityArithmetic},
+            {"merge-stack-adjust", &PeepholeOptimizer::mergeStackAdjust},
+            {"redundant-move-back", &PeepholeOptimizer::removeMoveBack},
+            {"overwritten-move", &PeepholeOptimizer::removeOverwrittenMove},
+            {"unreachable", &PeepholeOptimizer::removeUnreachable},
+            {"jump-thread", &PeepholeOptimizer::threadJump},
+            {"branch-over-jump", &PeepholeOptimizer::invertBranchOverJump},
+            {"jump-to-next", &PeepholeOptimizer::removeJumpToNext},
+        };
+        num = sizeof(table) / sizeof(table[0]);
+        return table;
+    }
+
+    static bool isJump(const MInst &inst)
+    {
+        return inst.op == M_JMP || inst.op == M_JCC;
+    }
+
+    static bool isReg(const Operand &opd)
+    {
+        return opd.kind == OPD_PREG;
+    }
+
+    void countLabelRefs()
+    {
+        labelRefs.clear();
+        for (auto &inst : insts)
+        {
+            if (isJump(inst))
+                labelRefs[inst.a.name]++;
+        }
+    }
+
+    void erase(size_t i)
+    {
+        if (isJump(insts[i]))
+            labelRefs[insts[i].a.name]--;
+        if (insts[i].op != M_LABEL)
+            removed++;
+        insts.erase(insts.begin() + i);
+    }
+
+    // 跳转目标标签之后的第一条指令的下标
+    size_t targetOf(const std::string &label) const
+    {
+        for (size_t i = 0; i < insts.size(); i++)
+        {
+            if (insts[i].op == M_LABEL && insts[i].a.name == label)
+            {
+                while (i < insts.size() && insts[i].op == M_LABEL)
+                    i++;
+                return i;
+            }
+        }
+        return insts.size();
+    }
+
+    // mov R, R
+    bool removeSelfMove(size_t i)
+    {
+        if (insts[i].op == M_MOV && insts[i].a == insts[i].b)
+        {
+            erase(i);
+            return true;
+        }
+        return false;
+    }
+
+    // add R, 0 / sub R, 0 / imul R, 1 等，生成的代码不依赖这些指令设置的标志位
+    bool removeIdentityArithmetic(size_t i)
+    {
+        const MInst &inst = insts[i];
+        if (!inst.b.isImm())
+            return false;
+        bool identity = false;
+        switch (inst.op)
+        {
+        case M_ADD:
+        case M_SUB:
+        case M_OR:
+        case M_XOR:
+        case M_SAL:
+        case M_SAR:
+        case M_SHR:
+            identity = inst.b.value == 0;
+            break;
+        case M_IMUL:
+            identity = inst.b.value == 1;
+            break;
+        case M_AND:
+            identity = inst.b.value == -1;
+            break;
+        default:
+            break;
+        }
+        if (identity)
+        {
+            erase(i);
+            return true;
+        }
+        return false;
+    }
+
+    // add esp, a / add esp, b => add esp, a+b
+    bool mergeStackAdjust(size_t i)
+    {
+        if (i + 1 >= insts.size())
+            return false;
+        MInst &first = insts[i];
+        const MInst &second = insts[i + 1];
+        if (first.op == M_ADD && first.a.isPReg(ESP) && first.b.isImm() &&
+            second.op == M_ADD && second.a.isPReg(ESP) && second.b.isImm())
+        {
+            first.b.value += second.b.value;
+            erase(i + 1);
+            return true;
+        }
+        return false;
+    }
+
+    // mov A, B / mov B, A => mov A, B
+    bool removeMoveBack(size_t i)
+    {
+        if (i + 1 >= insts.size())
+            return false;
+        const MInst &first = insts[i];
+        const MInst &second = insts[i + 1];
+        if (first.op == M_MOV && second.op == M_MOV && first.a == second.b && first.b == second.a)
+        {
+            erase(i + 1);
+            return true;
+        }
+        return false;
+    }
+
+    // mov R, X / mov R, Y => mov R, Y，Y中不能引用R
+    bool removeOverwrittenMove(size_t i)
+    {
+        if (i + 1 >= insts.size())
+            return false;
+        const MInst &first = insts[i];
+        const MInst &second = insts[i + 1];
+        if (first.op == M_MOV && second.op == M_MOV && isReg(first.a) && first.a == second.a && second.b != first.a)
+        {
+            erase(i);
+            return true;
+        }
+        return false;
+    }
+
+    // jmp、ret和尾调用之后，到下一个被引用的标签之前的指令都不可达
+    bool removeUnreachable(size_t i)
+    {
+        if (insts[i].op != M_JMP && insts[i].op != M_RET && insts[i].op != M_TAILJMP)
+            return false;
+        bool changed = false;
+        while (i + 1 < insts.size())
+        {
+            const MInst &next = insts[i + 1];
+            if (next.op == M_LABEL && labelRefs[next.a.name] > 0)
+                break;
+            erase(i + 1);
+            changed = true;
+        }
+        return changed;
+    }
+
+    // 跳转到另一条无条件跳转时，直接跳到最终目标
+    bool threadJump(size_t i)
+    {
+        if (!isJump(insts[i]))
+            return false;
+        size_t target = targetOf(insts[i].a.name);
+        if (target < insts.size() && insts[target].op == M_JMP && insts[target].a != insts[i].a)
+        {
+            labelRefs[insts[i].a.name]--;
+            insts[i].a = insts[target].a;
+            labelRefs[insts[i].a.name]++;
+            return true;
+        }
+        return false;
+    }
+
+    // jcc L1 / jmp L2 / L1: => jncc L2 / L1:
+    bool invertBranchOverJump(size_t i)
+    {
+        if (i + 2 >= insts.size())
+            return false;
+        MInst &branch = insts[i];
+        const MInst &jump = insts[i + 1];
+        const MInst &label = insts[i + 2];
+        if (branch.op == M_JCC && jump.op == M_JMP && label.op == M_LABEL && branch.a == label.a)
+        {
+            labelRefs[branch.a.name]--;
+            branch.cc = invertCondCode(branch.cc);
+            branch.a = jump.a;
+            labelRefs[branch.a.name]++;
+            erase(i + 1);
+            return true;
+        }
+        return false;
+    }
+
+    // jmp L / L: => L:，中间可以隔着其他标签
+    bool removeJumpToNext(size_t i)
+    {
+        if (!isJump(insts[i]))
+            return false;
+        for (size_t k = i + 1; k < insts.size() && insts[k].op == M_LABEL; k++)
+        {
+            if (insts[k].a == insts[i].a)
+            {
+                erase(i);
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+#endif
@@ -0,0 +1,625 @@
+#ifndef __REGISTERALLOCATOR_H__
+#define __REGISTERALLOCATOR_H__
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "AsmCode.h"
+
+// 基于活跃区间的线性扫描寄存器分配器
+// 寄存器编号：0~PHYS_REG_ALLOCATABLE-1为物理寄存器，之后为虚拟寄存器
+// 指令i读操作数的位置为2i，写操作数的位置为2i+1
+class RegisterAllocator
+{
+private:
+    // 位集合，用于活跃变量分析
+    class BitSet
+    {
+    public:
+        std::vector<uint64_t> words;
+
+        BitSet(size_t n = 0) : words((n + 63) / 64, 0) {}
+
+        void set(int i) { words[i >> 6] |= (uint64_t)1 << (i & 63); }
+        void reset(int i) { words[i >> 6] &= ~((uint64_t)1 << (i & 63)); }
+        bool test(int i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+
+        // 并入other，返回自身是否改变
+        bool merge(const BitSet &other)
+        {
+            bool changed = false;
+            for (size_t i = 0; i < words.size(); i++)
+            {
+                uint64_t w = words[i] | other.words[i];
+                changed |= w != words[i];
+                words[i] = w;
+            }
+            return changed;
+        }
+    };
+
+    // 基本块
+    struct Block
+    {
+        int first, last; // 包含的指令下标[first, last]
+        std::vector<int> succs;
+        BitSet gen, kill, liveIn, liveOut;
+    };
+
+    // 虚拟寄存器的活跃区间
+    struct Interval
+    {
+        int vreg;
+        int start = INT32_MAX;
+        int end = -1;
+        double weight = 0; // 溢出代价，循环内的引用权重更高
+        int reg = -1;      // 分配到的物理寄存器
+        bool spilled = false;
+    };
+
+    AsmFunction &func;
+    std::vector<Block> blocks;
+    std::vector<Interval> intervals;                          // 按虚拟寄存器编号索引
+    std::vector<std::vector<std::pair<int, int>>> fixedRanges; // 物理寄存器被占用的区间
+    std::vector<int> hints;                                   // 虚拟寄存器希望分配到的寄存器编号
+    std::vector<bool> unspillable;                            // 溢出代码引入的临时寄存器不能再溢出
+
+    static int regId(const Operand &opd)
+    {
+        if (opd.kind == OPD_VREG)
+            return PHYS_REG_ALLOCATABLE + opd.value;
+        if (opd.kind == OPD_PREG && opd.value < PHYS_REG_ALLOCATABLE)
+            return opd.value;
+        return -1;
+    }
+
+    static void addReg(std::vector<int> &regs, const Operand &opd)
+    {
+        int id = regId(opd);
+        if (id >= 0)
+            regs.push_back(id);
+    }
+
+public:
+    // 获取指令读和写的寄存器编号，包括隐式使用的物理寄存器
+    // x86-64下调用读取传递参数的寄存器，并破坏所有调用者保存寄存器
+    void getInstRegs(const MInst &inst, std::vector<int> &uses, std::vector<int> &defs) const
+    {
+        uses.clear();
+        defs.clear();
+        switch (inst.op)
+        {
+        case M_MOV:
+        case M_LEA:
+            addReg(uses, inst.b);
+            addReg(defs, inst.a);
+            break;
+        case M_ADD:
+        case M_SUB:
+        case M_IMUL:
+        case M_AND:
+        case M_OR:
+        case M_XOR:
+        case M_SAL:
+        case M_SAR:
+        case M_SHR:
+            addReg(uses, inst.a);
+            addReg(uses, inst.b);
+            addReg(defs, inst.a);
+            break;
+        case M_NEG:
+        case M_NOT:
+            addReg(uses, inst.a);
+            addReg(defs, inst.a);
+            break;
+        case M_CMP:
+        case M_TEST:
+            addReg(uses, inst.a);
+            addReg(uses, inst.b);
+            break;
+        case M_SETCC:
+            defs.push_back(EAX);
+            break;
+        case M_MOVZX:
+            uses.push_back(EAX);
+            addReg(defs, inst.a);
+            break;
+        case M_CDQ:
+            uses.push_back(EAX);
+            defs.push_back(EDX);
+            break;
+        case M_IDIV:
+            addReg(uses, inst.a);
+            uses.push_back(EAX);
+            uses.push_back(EDX);
+            defs.push_back(EAX);
+            defs.push_back(EDX);
+            break;
+        case M_IMULH:
+            addReg(uses, inst.a);
+            uses.push_back(EAX);
+            defs.push_back(EAX);
+            defs.push_back(EDX);
+            break;
+        case M_PUSH:
+            addReg(uses, inst.a);
+            break;
+        case M_CALL:
+            for (int i = 0; i < inst.regArgs; i++)
+                uses.push_back(ARG_REGS[i]);
+            if (inst.variadic)
+                uses.push_back(EAX);
+            for (PhysReg reg : callerSavedRegs(func.target))
+                defs.push_back(reg);
+            break;
+        case M_TAILJMP:
+            for (int i = 0; i < inst.regArgs; i++)
+                uses.push_back(ARG_REGS[i]);
+            break;
+        case M_RET:
+            uses.push_back(EAX);
+            break;
+        default:
+            break;
+        }
+    }
+
+    RegisterAllocator(AsmFunction &func) : func(func) {}
+
+    void allocate()
+    {
+        unspillable.assign(func.vregNum, false);
+        bool removeDead = true;
+        for (;;)
+        {
+            buildBlocks();
+            computeLiveness();
+            if (removeDead)
+            {
+                removeDead = removeDeadCode();
+                if (removeDead)
+                    continue;
+            }
+            buildIntervals();
+            if (linearScan())
+                break;
+            insertSpillCode();
+        }
+        assignRegisters();
+    }
+
+private:
+    int regNum() const
+    {
+        return PHYS_REG_ALLOCATABLE + func.vregNum;
+    }
+
+    // 以标签和跳转指令为界划分基本块，并建立控制流边
+    void buildBlocks()
+    {
+        blocks.clear();
+        std::map<std::string, int> labelBlock;
+        auto &insts = func.insts;
+        int n = insts.size();
+        int first = 0;
+        for (int i = 0; i < n; i++)
+        {
+            if (insts[i].op == M_LABEL && i != first)
+            {
+                Block b;
+                b.first = first;
+                b.last = i - 1;
+                blocks.push_back(b);
+                first = i;
+            }
+            if (insts[i].op == M_LABEL)
+            {
+                labelBlock[insts[i].a.name] = blocks.size();
+            }
+            if (insts[i].op == M_JMP || insts[i].op == M_JCC || insts[i].op == M_RET || insts[i].op == M_TAILJMP)
+            {
+                Block b;
+                b.first = first;
+                b.last = i;
+                blocks.push_back(b);
+                first = i + 1;
+            }
+        }
+        if (first < n)
+        {
+            Block b;
+            b.first = first;
+            b.last = n - 1;
+            blocks.push_back(b);
+        }
+
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            const MInst &last = insts[blocks[i].last];
+            if (last.op == M_JMP || last.op == M_JCC)
+            {
+                blocks[i].succs.push_back(labelBlock.at(last.a.name));
+            }
+            if (last.op != M_JMP && last.op != M_RET && last.op != M_TAILJMP && i + 1 < blocks.size())
+            {
+                blocks[i].succs.push_back(i + 1);
+            }
+        }
+    }
+
+    void computeLiveness()
+    {
+        std::vector<int> uses, defs;
+        for (auto &b : blocks)
+        {
+            b.gen = BitSet(regNum());
+            b.kill = BitSet(regNum());
+            b.liveIn = BitSet(regNum());
+            b.liveOut = BitSet(regNum());
+            for (int i = b.first; i <= b.last; i++)
+            {
+                getInstRegs(func.insts[i], uses, defs);
+                for (int r : uses)
+                    if (!b.kill.test(r))
+                        b.gen.set(r);
+                for (int r : defs)
+                    b.kill.set(r);
+            }
+        }
+
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            for (int i = blocks.size() - 1; i >= 0; i--)
+            {
+                Block &b = blocks[i];
+                for (int s : b.succs)
+                    b.liveOut.merge(blocks[s].liveIn);
+                BitSet in = b.liveOut;
+                for (size_t w = 0; w < in.words.size(); w++)
+                    in.words[w] = (in.words[w] & ~b.kill.words[w]) | b.gen.words[w];
+                changed |= b.liveIn.merge(in);
+            }
+        }
+    }
+
+    // 删除结果不再被使用的计算指令，返回是否有指令被删除
+    bool removeDeadCode()
+    {
+        std::vector<bool> dead(func.insts.size(), false);
+        std::vector<int> uses, defs;
+        bool changed = false;
+        for (auto &b : blocks)
+        {
+            BitSet live = b.liveOut;
+            for (int i = b.last; i >= b.first; i--)
+            {
+                const MInst &inst = func.insts[i];
+                getInstRegs(inst, uses, defs);
+                bool pure = inst.op == M_MOV || inst.op == M_LEA || inst.op == M_ADD || inst.op == M_SUB ||
+                            inst.op == M_IMUL || inst.op == M_AND || inst.op == M_OR || inst.op == M_XOR ||
+                            inst.op == M_NEG || inst.op == M_NOT || inst.op == M_SAL || inst.op == M_SAR ||
+                            inst.op == M_SHR || inst.op == M_MOVZX;
+                if (pure && inst.a.isVReg() && !live.test(regId(inst.a)))
+                {
+                    dead[i] = true;
+                    changed = true;
+                    continue;
+                }
+                for (int r : defs)
+                    live.reset(r);
+                for (int r : uses)
+                    live.set(r);
+            }
+        }
+        if (changed)
+        {
+            std::vector<MInst> insts;
+            for (size_t i = 0; i < func.insts.size(); i++)
+                if (!dead[i])
+                    insts.push_back(func.insts[i]);
+            func.insts.swap(insts);
+        }
+        return changed;
+    }
+
+    // 倒序扫描每个基本块，求出每个寄存器的活跃范围
+    void buildIntervals()
+    {
+        int n = regNum();
+        std::vector<std::vector<std::pair<int, int>>> ranges(n);
+        auto addRange = [&](int r, int from, int to)
+        {
+            auto &rs = ranges[r];
+            if (!rs.empty() && rs.back().first <= to + 1)
+                rs.back().first = std::min(rs.back().first, from);
+            else
+                rs.push_back(std::make_pair(from, to));
+        };
+
+        intervals.assign(func.vregNum, Interval());
+        hints.assign(func.vregNum, -1);
+        std::vector<int> uses, defs;
+        for (int bi = blocks.size() - 1; bi >= 0; bi--)
+        {
+            const Block &b = blocks[bi];
+            int from = 2 * b.first, to = 2 * b.last + 1;
+            for (int r = 0; r < n; r++)
+                if (b.liveOut.test(r))
+                    addRange(r, from, to);
+
+            for (int i = b.last; i >= b.first; i--)
+            {
+                const MInst &inst = func.insts[i];
+                getInstRegs(inst, uses, defs);
+                for (int r : defs)
+                {
+                    auto &rs = ranges[r];
+                    if (!rs.empty() && rs.back().first <= 2 * i + 1 && rs.back().second >= 2 * i + 1)
+                        rs.back().first = 2 * i + 1;
+                    else
+                        addRange(r, 2 * i + 1, 2 * i + 1);
+                }
+                for (int r : uses)
+                    addRange(r, from, 2 * i);
+
+                double weight = 1;
+                for (int d = 0; d < inst.loopDepth && d < 6; d++)
+                    weight *= 10;
+                for (int r : uses)
+                    if (r >= PHYS_REG_ALLOCATABLE)
+                        intervals[r - PHYS_REG_ALLOCATABLE].weight += weight;
+                for (int r : defs)
+                    if (r >= PHYS_REG_ALLOCATABLE)
+                        intervals[r - PHYS_REG_ALLOCATABLE].weight += weight;
+
+                // 寄存器之间的传送指令，尽量让两端分配到同一个寄存器
+                if (inst.op == M_MOV && inst.a.isVReg() && regId(inst.b) >= 0)
+                    hints[inst.a.value] = regId(inst.b);
+                else if (inst.op == M_MOV && inst.b.isVReg() && inst.a.kind == OPD_PREG && regId(inst.a) >= 0)
+                    hints[inst.b.value] = regId(inst.a);
+            }
+        }
+
+        fixedRanges.assign(PHYS_REG_ALLOCATABLE, std::vector<std::pair<int, int>>());
+        for (int r = 0; r < n; r++)
+        {
+            auto &rs = ranges[r];
+            if (rs.empty())
+                continue;
+            if (r < PHYS_REG_ALLOCATABLE)
+            {
+                fixedRanges[r].assign(rs.rbegin(), rs.rend());
+                std::sort(fixedRanges[r].begin(), fixedRanges[r].end());
+            }
+            else
+            {
+                Interval &it = intervals[r - PHYS_REG_ALLOCATABLE];
+                it.vreg = r - PHYS_REG_ALLOCATABLE;
+                for (auto &range : rs)
+                {
+                    it.start = std::min(it.start, range.first);
+                    it.end = std::max(it.end, range.second);
+                }
+            }
+        }
+    }
+
+    // 物理寄存器reg在[start, end]内是否被指令固定占用
+    bool fixedConflict(int reg, int start, int end) const
+    {
+        const auto &rs = fixedRanges[reg];
+        auto it = std::lower_bound(rs.begin(), rs.end(), std::make_pair(start, INT32_MIN));
+        if (it != rs.end() && it->first <= end)
+            return true;
+        if (it != rs.begin() && (it - 1)->second >= start)
+            return true;
+        return false;
+    }
+
+    // 线性扫描分配寄存器，没有新的溢出时返回true
+    bool linearScan()
+    {
+        const std::vector<PhysReg> &order = allocatableRegs(func.target);
+
+        std::vector<Interval *> sorted;
+        for (auto &it : intervals)
+            if (it.end >= 0)
+                sorted.push_back(&it);
+        std::sort(sorted.begin(), sorted.end(), [](const Interval *x, const Interval *y)
+                  { return x->start < y->start || (x->start == y->start && x->vreg < y->vreg); });
+
+        std::vector<Interval *> active;
+        bool noSpill = true;
+        for (Interval *cur : sorted)
+        {
+            active.erase(std::remove_if(active.begin(), active.end(), [cur](const Interval *it)
+                                        { return it->end < cur->start; }),
+                         active.end());
+
+            bool usable[PHYS_REG_ALLOCATABLE];
+            for (int r = 0; r < PHYS_REG_ALLOCATABLE; r++)
+                usable[r] = !fixedConflict(r, cur->start, cur->end);
+            bool free[PHYS_REG_ALLOCATABLE];
+            for (int r = 0; r < PHYS_REG_ALLOCATABLE; r++)
+                free[r] = usable[r];
+            for (Interval *it : active)
+                free[it->reg] = false;
+
+            int hint = hints[cur->vreg];
+            if (hint >= PHYS_REG_ALLOCATABLE)
+                hint = intervals[hint - PHYS_REG_ALLOCATABLE].spilled ? -1 : intervals[hint - PHYS_REG_ALLOCATABLE].reg;
+            if (hint >= 0 && free[hint])
+                cur->reg = hint;
+            else
+                for (int r : order)
+                    if (free[r])
+                    {
+                        cur->reg = r;
+                        break;
+                    }
+
+            if (cur->reg >= 0)
+            {
+                active.push_back(cur);
+                continue;
+            }
+
+            // 没有空闲的寄存器，溢出代价最小的区间
+            Interval *victim = nullptr;
+            for (Interval *it : active)
+                if (usable[it->reg] && !unspillable[it->vreg] && (victim == nullptr || it->weight < victim->weight))
+                    victim = it;
+            noSpill = false;
+            if (victim != nullptr && (unspillable[cur->vreg] || victim->weight < cur->weight))
+            {
+                cur->reg = victim->reg;
+                victim->reg = -1;
+                victim->spilled = true;
+                *std::find(active.begin(), active.end(), victim) = cur;
+            }
+            else if (!unspillable[cur->vreg])
+            {
+                cur->spilled = true;
+            }
+            else
+            {
+                std::cerr << "[ERROR] Register allocation failed in " << func.name << std::endl;
+                std::exit(1);
+            }
+        }
+        return noSpill;
+    }
+
+    // 指令的操作数是否可以直接换成内存单元
+    bool memoryAllowed(const MInst &inst, bool isA) const
+    {
+        if (inst.a.isMem() || inst.b.isMem())
+            return false;
+        switch (inst.op)
+        {
+        case M_MOV:
+        case M_ADD:
+        case M_SUB:
+        case M_AND:
+        case M_OR:
+        case M_XOR:
+        case M_CMP:
+        case M_TEST:
+            return true;
+        case M_IMUL:
+            return !isA;
+        case M_NEG:
+        case M_NOT:
+        case M_SAL:
+        case M_SAR:
+        case M_SHR:
+        case M_IDIV:
+        case M_IMULH:
+            return isA;
+        case M_PUSH:
+            // x86-64下压栈8字节，栈单元只有4字节
+            return isA && func.target != TARGET_X86_64;
+        default:
+            return false;
+        }
+    }
+
+    // 为溢出的虚拟寄存器分配栈单元，并改写引用它们的指令
+    void insertSpillCode()
+    {
+        std::vector<int> slots(func.vregNum, 0);
+        for (auto &it : intervals)
+            if (it.spilled)
+            {
+                slots[it.vreg] = func.allocSlot();
+                func.spillSlotNum++;
+            }
+
+        std::vector<MInst> insts;
+        for (MInst inst : func.insts)
+        {
+            std::vector<MInst> after;
+            bool readsA = inst.op != M_MOV && inst.op != M_MOVZX && (inst.op != M_LEA || inst.a == inst.b);
+            bool writesA = inst.op != M_CMP && inst.op != M_TEST && inst.op != M_PUSH && inst.op != M_IDIV &&
+                           inst.op != M_IMULH;
+            Operand *opds[] = {&inst.a, &inst.b};
+            for (int k = 0; k < 2; k++)
+            {
+                Operand &opd = *opds[k];
+                if (!opd.isVReg() || opd.value >= (int)slots.size() || slots[opd.value] == 0)
+                    continue;
+                Operand slot = Operand::mem(slots[opd.value]);
+                int vreg = opd.value;
+                // 同一个寄存器同时出现在两个操作数中时，第二个操作数留给临时寄存器
+                if (memoryAllowed(inst, k == 0))
+                {
+                    opd = slot;
+                    continue;
+                }
+                Operand temp = func.newVReg();
+                unspillable.push_back(true);
+                bool reads = k == 1 || readsA;
+                bool writes = k == 0 && writesA;
+                if (reads)
+                {
+                    MInst load = inst;
+                    load.op = M_MOV;
+                    load.a = temp;
+                    load.b = slot;
+                    insts.push_back(load);
+                }
+                if (writes)
+                {
+                    MInst store = inst;
+                    store.op = M_MOV;
+                    store.a = slot;
+                    store.b = temp;
+                    after.push_back(store);
+                }
+                opd = temp;
+                if (k == 0 && inst.b.isVReg() && inst.b.value == vreg)
+                    inst.b = temp;
+            }
+            insts.push_back(inst);
+            insts.insert(insts.end(), after.begin(), after.end());
+        }
+        func.insts.swap(insts);
+    }
+
+    // 用分配结果替换虚拟寄存器，去掉多余的传送指令，并记录需要保存的寄存器
+    void assignRegisters()
+    {
+        bool used[PHYS_REG_ALLOCATABLE] = {false};
+        std::vector<MInst> insts;
+        for (MInst inst : func.insts)
+        {
+            Operand *opds[] = {&inst.a, &inst.b};
+            for (Operand *opd : opds)
+            {
+                if (opd->isVReg())
+                {
+                    int reg = intervals[opd->value].reg;
+                    *opd = Operand::preg((PhysReg)reg);
+                    used[reg] = true;
+                }
+            }
+            if (inst.op == M_MOV && inst.a == inst.b)
+                continue;
+            insts.push_back(inst);
+        }
+        func.insts.swap(insts);
+
+        for (PhysReg reg : calleeSavedRegs(func.target))
+            if (used[reg])
+                func.savedRegs.push_back(std::make_pair(reg, func.allocSlot(func.regBytes())));
+    }
+};
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef __SOURCEFILE_H__
+#define __SOURCEFILE_H__
+
+#include <cstddef>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 记号在源文件中的位置，作为语法分析器的位置类型(YYLTYPE)
+struct SourceLocation
+{
+    int line = 1;      // 行号，从1开始
+    size_t offset = 0; // 记号第一个字符在源文件映射中的偏移
+};
+
+// 以内存映射方式打开的源文件，词法分析直接扫描映射，不再把文件读进缓冲区
+// 映射是可写的私有映射(MAP_PRIVATE)，flex在扫描时会临时改写记号后面的字符，这些改动不会写回文件
+// 文件内容之后还有两个'\0'，整个映射可以直接交给yy_scan_buffer
+class SourceFile
+{
+public:
+    static const size_t PADDING = 2; // 末尾'\0'的个数
+
+    SourceFile() {}
+    SourceFile(const SourceFile &) = delete;
+    SourceFile &operator=(const SourceFile &) = delete;
+
+    ~SourceFile()
+    {
+        close();
+    }
+
+    // 映射文件fileName，成功时返回true
+    bool open(const std::string &fileName)
+    {
+        close();
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd == -1)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode))
+        {
+            ::close(fd);
+            return false;
+        }
+
+        // 先保留一段全零的匿名映射，再把文件映射到它的开头
+        // 文件最后一页中超出文件长度的部分由内核填零；文件长度恰好是页大小的整数倍时，末尾的'\0'落在匿名映射上
+        size_t length = info.st_size;
+        void *base = mmap(nullptr, length + PADDING, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        if (length > 0 && mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED)
+        {
+            munmap(base, length + PADDING);
+            ::close(fd);
+            return false;
+        }
+        ::close(fd); // 映射建立后不再需要文件描述符
+
+        buffer = static_cast<char *>(base);
+        bufferSize = length;
+        return true;
+    }
+
+    void close()
+    {
+        if (buffer != nullptr)
+        {
+            munmap(buffer, bufferSize + PADDING);
+            buffer = nullptr;
+            bufferSize = 0;
+        }
+    }
+
+    // 文件内容的起始地址，data()[size()]和data()[size()+1]都是'\0'
+    char *data() const
+    {
+        return buffer;
+    }
+
+    // 文件长度，不含末尾的'\0'
+    size_t size() const
+    {
+        return bufferSize;
+    }
+
+private:
+    char *buffer = nullptr;
+    size_t bufferSize = 0;
+};
+
+#endif
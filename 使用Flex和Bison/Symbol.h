@@ -0,0 +1,107 @@
+#ifndef __SYMBOL_H__
+#define __SYMBOL_H__
+
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+// 驻留后的标识符，同名的标识符只有一个Symbol，比较两个名字只需比较指针
+struct Symbol
+{
+    std::string name;
+    int id;        // 按第一次出现的顺序编号，可以直接作为数组下标
+    unsigned hash; // 名字的哈希值，扩容时不必重新计算
+};
+
+// 每个SymbolTable最先驻留的名字，它们在任何一张表中的编号都相同
+enum BuiltinSymbolId
+{
+    MAIN_SYMBOL_ID = 0,  // main
+    PRINT_SYMBOL_ID = 1, // println_int
+};
+
+// 标识符驻留表：词法分析时把每个标识符换成唯一的Symbol
+// 开放定址的哈希表，查找已经出现过的名字时不分配内存
+class SymbolTable
+{
+private:
+    // 先于mainSymbol等成员构造，构造函数中就可以驻留名字
+    std::deque<Symbol> symbols;    // deque扩容时不移动已有元素，Symbol的地址保持不变
+    std::vector<Symbol *> buckets; // 大小是2的幂，装载因子不超过1/2
+
+public:
+    const Symbol *const mainSymbol;  // main
+    const Symbol *const printSymbol; // println_int
+
+    SymbolTable() : mainSymbol(intern("main")), printSymbol(intern("println_int")) {}
+
+    SymbolTable(const SymbolTable &) = delete;
+    SymbolTable &operator=(const SymbolTable &) = delete;
+
+    const Symbol *intern(const char *text)
+    {
+        return intern(text, std::strlen(text));
+    }
+
+    const Symbol *intern(const char *text, size_t length)
+    {
+        unsigned hash = hashOf(text, length);
+        if ((symbols.size() + 1) * 2 > buckets.size())
+            grow();
+        size_t mask = buckets.size() - 1;
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            Symbol *symbol = buckets[i];
+            if (symbol == nullptr)
+            {
+                symbols.push_back(Symbol());
+                symbol = &symbols.back();
+                symbol->name.assign(text, length);
+                symbol->id = symbols.size() - 1;
+                symbol->hash = hash;
+                buckets[i] = symbol;
+                return symbol;
+            }
+            if (symbol->hash == hash && symbol->name.size() == length && std::memcmp(symbol->name.data(), text, length) == 0)
+                return symbol;
+        }
+    }
+
+    size_t size() const
+    {
+        return symbols.size();
+    }
+
+private:
+    // FNV-1a
+    static unsigned hashOf(const char *text, size_t length)
+    {
+        unsigned hash = 2166136261u;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= (unsigned char)text[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    void grow()
+    {
+        std::vector<Symbol *> old;
+        old.swap(buckets);
+        buckets.assign(old.empty() ? 64 : old.size() * 2, nullptr);
+        size_t mask = buckets.size() - 1;
+        for (auto it = old.begin(); it != old.end(); it++)
+        {
+            if (*it == nullptr)
+                continue;
+            size_t i = (*it)->hash & mask;
+            while (buckets[i] != nullptr)
+                i = (i + 1) & mask;
+            buckets[i] = *it;
+        }
+    }
+};
+
+#endif
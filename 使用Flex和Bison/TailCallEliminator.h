@@ -0,0 +1,138 @@
+#ifndef __TAILCALLELIMINATOR_H__
+#define __TAILCALLELIMINATOR_H__
+
+#include <vector>
+
+#include "IR.h"
+
+// 尾调用消除：调用之后直接返回它的结果的调用，如return f(n - 1, acc * n);
+// 1. 调用自身时把实参赋给参数，跳回函数开头，递归变成循环，不再占用栈空间
+// 2. 调用其他自定义函数时改为IR_TAILCALL，由后端释放本函数的栈帧后直接跳过去
+//    通过栈传递的实参写到本函数的参数所在的栈单元，所以个数不能多于本函数通过栈传递的参数
+// println_int由printf实现，调用约定不同，不做处理
+class TailCallEliminator
+{
+public:
+    int recursionNum = 0; // 变成循环的递归调用个数
+    int tailCallNum = 0;  // 变成IR_TAILCALL的调用个数
+
+    TailCallEliminator(IRFunction &func) : func(func) {}
+
+    void run()
+    {
+        bool recursive = false;
+        for (auto block = func.blocks.begin(); block != func.blocks.end(); block++)
+        {
+            const IRInst *call = tailCall(*block);
+            recursive |= call != nullptr && call->callee == func.symbol;
+        }
+        // 入口块不能作为跳转目标，把它的指令移到新的循环头中
+        int header = recursive ? splitEntry() : -1;
+
+        for (auto block = func.blocks.begin(); block != func.blocks.end(); block++)
+        {
+            const IRInst *call = tailCall(*block);
+            if (call == nullptr)
+                continue;
+            if (call->callee == func.symbol)
+            {
+                std::vector<IRValue> args = call->args;
+                block->insts.resize(block->insts.size() - 2);
+                genRecursion(*block, args, header);
+                recursionNum++;
+            }
+            else if (call->callee->id != PRINT_SYMBOL_ID && stackArgNum(call->args.size()) <= stackArgNum(func.paramNum))
+            {
+                IRInst tail = *call;
+                tail.op = IR_TAILCALL;
+                tail.dst = IRValue();
+                block->insts.resize(block->insts.size() - 2);
+                block->insts.push_back(tail);
+                tailCallNum++;
+            }
+        }
+        func.computeCFG();
+    }
+
+private:
+    IRFunction &func;
+
+    static bool returns(const IRInst &inst, const IRValue &result)
+    {
+        return inst.op == IR_RET && (inst.a.isNone() || inst.a == result);
+    }
+
+    // 基本块以尾调用结尾时返回这个调用：调用之后是返回它的结果的ret，
+    // 或者跳到只有这样一条ret的基本块（void函数末尾的调用）
+    const IRInst *tailCall(const IRBlock &block) const
+    {
+        if (block.insts.size() < 2)
+            return nullptr;
+        const IRInst &call = block.insts[block.insts.size() - 2];
+        const IRInst &term = block.insts.back();
+        if (call.op != IR_CALL)
+            return nullptr;
+        if (returns(term, call.dst))
+            return &call;
+        if (term.op == IR_JMP && func.blocks[term.target].insts.size() == 1 &&
+            returns(func.blocks[term.target].insts[0], call.dst))
+            return &call;
+        return nullptr;
+    }
+
+    int splitEntry()
+    {
+        IRBlock header = func.blocks[0];
+        header.label = "tailrec";
+        func.blocks.insert(func.blocks.begin() + 1, header);
+        IRInst jump;
+        jump.op = IR_JMP;
+        jump.target = 1;
+        func.blocks[0].insts.assign(1, jump);
+        for (size_t b = 1; b < func.blocks.size(); b++)
+        {
+            func.blocks[b].id = b;
+            IRInst &term = func.blocks[b].insts.back();
+            if (term.op != IR_JMP && term.op != IR_BR)
+                continue;
+            term.target++;
+            if (term.op == IR_BR)
+                term.falseTarget++;
+        }
+        func.computeCFG();
+        return 1;
+    }
+
+    // 参数同时赋值：实参引用了之前会被覆盖的参数时先复制一份
+    void genRecursion(IRBlock &block, std::vector<IRValue> &args, int header)
+    {
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            if (args[i].isVReg() && args[i].value < func.paramNum && args[i].value != (int)i)
+            {
+                IRInst copy;
+                copy.op = IR_COPY;
+                copy.dst = func.newVReg();
+                copy.a = args[i];
+                block.insts.push_back(copy);
+                args[i] = copy.dst;
+            }
+        }
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            if (args[i] == IRValue::vreg(i))
+                continue;
+            IRInst copy;
+            copy.op = IR_COPY;
+            copy.dst = IRValue::vreg(i);
+            copy.a = args[i];
+            block.insts.push_back(copy);
+        }
+        IRInst jump;
+        jump.op = IR_JMP;
+        jump.target = header;
+        block.insts.push_back(jump);
+    }
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef __TASKPOOL_H__
+#define __TASKPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取的线程池
+// 每个线程有自己的任务队列，新任务放在当前线程队列的尾部，自己也从尾部取；自己的队列空了就从别的队列头部偷任务
+// parallelFor可以嵌套调用：等待一批任务完成的线程同时也在执行任务，线程不会都停在等待上
+class TaskPool
+{
+public:
+    // threadNum是参与执行任务的线程总数，调用parallelFor的线程也算在内，因此只创建threadNum-1个工作线程
+    explicit TaskPool(int threadNum)
+    {
+        if (threadNum < 1)
+            threadNum = 1;
+        for (int i = 0; i < threadNum; i++)
+            queues.emplace_back(new Queue());
+        // 0号队列属于不在池中的线程，工作线程使用1号以后的队列
+        for (int i = 1; i < threadNum; i++)
+            threads.emplace_back(&TaskPool::workerLoop, this, (size_t)i);
+    }
+
+    TaskPool(const TaskPool &) = delete;
+    TaskPool &operator=(const TaskPool &) = delete;
+
+    ~TaskPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (auto &t : threads)
+            t.join();
+    }
+
+    size_t getThreadNum() const
+    {
+        return queues.size();
+    }
+
+    // 并行执行body(0)到body(count-1)，全部完成后返回
+    void parallelFor(size_t count, const std::function<void(size_t)> &body)
+    {
+        if (count == 0)
+            return;
+        if (count == 1 || queues.size() == 1)
+        {
+            for (size_t i = 0; i < count; i++)
+                body(i);
+            return;
+        }
+
+        std::atomic<size_t> remaining(count);
+        pendingNum += count;
+        Queue &queue = *queues[currentQueue()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            // 倒着放入，自己从尾部取时先执行下标小的任务，别的线程从头部偷下标大的任务
+            for (size_t i = count; i-- > 0;)
+                queue.tasks.push_back(Task{&body, i, &remaining});
+        }
+        {
+            // 持有锁再通知，避免工作线程检查完条件、还没有开始等待时错过通知
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        wakeup.notify_all();
+
+        while (remaining.load() > 0)
+        {
+            if (!runOne())
+                std::this_thread::yield();
+        }
+    }
+
+private:
+    struct Task
+    {
+        const std::function<void(size_t)> *body;
+        size_t index;
+        std::atomic<size_t> *remaining; // 所在的那批任务中还没有完成的个数
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // 当前线程所属的线程池和它的队列编号
+    struct ThreadState
+    {
+        const TaskPool *pool;
+        size_t queueIndex;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> pendingNum{0}; // 所有队列中的任务总数
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    bool stopping = false;
+
+    static ThreadState &threadState()
+    {
+        static thread_local ThreadState state = {nullptr, 0};
+        return state;
+    }
+
+    size_t currentQueue() const
+    {
+        const ThreadState &state = threadState();
+        return state.pool == this ? state.queueIndex : 0;
+    }
+
+    // 取出并执行一个任务，没有任务可做时返回false
+    bool runOne()
+    {
+        size_t self = currentQueue();
+        Task task;
+        bool found = false;
+        {
+            Queue &queue = *queues[self];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.tasks.empty())
+            {
+                task = queue.tasks.back();
+                queue.tasks.pop_back();
+                found = true;
+            }
+        }
+        for (size_t k = 1; !found && k < queues.size(); k++)
+        {
+            Queue &victim = *queues[(self + k) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty())
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                found = true;
+            }
+        }
+        if (!found)
+            return false;
+
+        pendingNum--;
+        (*task.body)(task.index);
+        // 计数减到0后等待的线程会立即返回，body和remaining随之失效，这里之后不能再访问它们
+        task.remaining->fetch_sub(1);
+        return true;
+    }
+
+    void workerLoop(size_t queueIndex)
+    {
+        threadState() = ThreadState{this, queueIndex};
+        while (true)
+        {
+            if (runOne())
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            wakeup.wait(lock, [this]()
+                        { return stopping || pendingNum.load() > 0; });
+            if (stopping && pendingNum.load() == 0)
+                return;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,543 @@
+#ifndef __X86BACKEND_H__
+#define __X86BACKEND_H__
+
+#include <algorithm>
+#include <climits>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "global.h"
+#include "IR.h"
+#include "AsmCode.h"
+#include "AsmWriter.h"
+#include "RegisterAllocator.h"
+#include "Peephole.h"
+#include "X86Encoder.h"
+
+// x86代码生成：把一个函数的IR翻译为带虚拟寄存器的机器指令，再做寄存器分配和窥孔优化
+// IR的第i个虚拟寄存器就是机器指令中的第i个虚拟寄存器
+// 目标平台由compilerOptions.target决定：32位使用cdecl调用约定，x86-64使用System V调用约定，
+// 两者的运算都是32位的，只有参数的传递方式和可用的寄存器不同
+class X86Backend
+{
+public:
+    X86Backend(const IRFunction &ir)
+        : ir(ir), func(asmName(ir.symbol), "_L_" + ir.symbol->name + "_", compilerOptions.target) {}
+
+    // 生成函数的机器指令并分配寄存器，统计信息写到diagnostics；之后用print或encode输出
+    void generate(std::ostream &diagnostics)
+    {
+        for (int i = 0; i < ir.vregNum; i++)
+        {
+            func.newVReg();
+        }
+
+        // 函数参数从寄存器或栈上读入虚拟寄存器
+        for (int i = 0; i < ir.paramNum; i++)
+        {
+            func.emit(M_MOV, Operand::vreg(i), paramLocation(i));
+        }
+
+        for (auto block = ir.blocks.begin(); block != ir.blocks.end(); block++)
+        {
+            func.depth = block->depth;
+            func.loopDepth = block->loopDepth;
+            if (block->id != 0)
+            {
+                func.emitLabel(label(block->id));
+                func.insts.back().depth = std::max(block->depth - 1, 1);
+            }
+            for (auto inst = block->insts.begin(); inst != block->insts.end(); inst++)
+            {
+                genInst(*block, *inst);
+            }
+        }
+
+        RegisterAllocator(func).allocate();
+        int removed = PeepholeOptimizer(func).optimize();
+        if (compilerOptions.printStats)
+        {
+            diagnostics << "[peephole] " << func.name << ": " << removed << " instructions removed" << std::endl;
+            diagnostics << "[frame] " << func.name << ": " << func.frameBytes() << " bytes ("
+                        << func.spillSlotNum << " spill slots, "
+                        << func.savedRegs.size() << " saved registers)" << std::endl;
+        }
+    }
+
+    // 输出汇编代码
+    void print(AsmWriter &out) const
+    {
+        func.print(out);
+    }
+
+    // 编码为机器码，用于直接输出目标文件
+    void encode(MachineCode &code) const
+    {
+        X86Encoder(func).encode(code);
+    }
+
+    // 汇编代码中的函数名，自定义函数加上前缀以免与C库中的函数重名
+    static std::string asmName(const Symbol *symbol)
+    {
+        return symbol->id == MAIN_SYMBOL_ID ? symbol->name : "__func_" + symbol->name;
+    }
+
+private:
+    const IRFunction &ir;
+    AsmFunction func;
+
+    std::string label(int block) const
+    {
+        return func.labelPrefix + ir.blocks[block].label;
+    }
+
+    bool isX86_64() const
+    {
+        return func.target == TARGET_X86_64;
+    }
+
+    // 第i个参数在本函数中的位置：32位时在栈上；x86-64时前6个在寄存器中，之后的在返回地址之上，每个8字节
+    Operand paramLocation(int i) const
+    {
+        if (!isX86_64())
+            return Operand::mem((i + 2) * 4);
+        if (i < ARG_REG_NUM)
+            return Operand::preg(ARG_REGS[i]);
+        return Operand::mem(16 + (i - ARG_REG_NUM) * 8);
+    }
+
+    bool paramAssigned(int param) const
+    {
+        for (auto block = ir.blocks.begin(); block != ir.blocks.end(); block++)
+        {
+            for (auto inst = block->insts.begin(); inst != block->insts.end(); inst++)
+            {
+                if (inst->hasDst() && inst->dst.value == param)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    static Operand operand(const IRValue &v)
+    {
+        return v.isImm() ? Operand::imm(v.value) : Operand::vreg(v.value);
+    }
+
+    static CondCode condCode(COperator cmp)
+    {
+        switch (cmp)
+        {
+        case CNE:
+            return CC_NE;
+        case CLT:
+            return CC_L;
+        case CLE:
+            return CC_LE;
+        case CGT:
+            return CC_G;
+        case CGE:
+            return CC_GE;
+        default:
+            return CC_E;
+        }
+    }
+
+    void genInst(const IRBlock &block, const IRInst &inst)
+    {
+        Operand dest = operand(inst.dst);
+        Operand l = operand(inst.a);
+        Operand r = operand(inst.b);
+        switch (inst.op)
+        {
+        case IR_COPY:
+            if (l != dest)
+                func.emit(M_MOV, dest, l);
+            break;
+        case IR_ADD:
+            genArithmetic(M_ADD, dest, l, r, true);
+            break;
+        case IR_SUB:
+            genArithmetic(M_SUB, dest, l, r, false);
+            break;
+        case IR_MUL:
+            if (l.isImm() && r.isVReg())
+                std::swap(l, r);
+            if (l.isVReg() && r.isImm())
+                genMulImm(dest, l, r.value);
+            else
+                genArithmetic(M_IMUL, dest, l, r, true);
+            break;
+        case IR_AND:
+            genArithmetic(M_AND, dest, l, r, true);
+            break;
+        case IR_OR:
+            genArithmetic(M_OR, dest, l, r, true);
+            break;
+        case IR_XOR:
+            genArithmetic(M_XOR, dest, l, r, true);
+            break;
+        case IR_DIV:
+        case IR_MOD:
+            if (l.isVReg() && r.isImm() && genDivImm(dest, l, r.value, inst.op == IR_MOD))
+                break;
+            r = func.toReg(r);
+            func.emit(M_MOV, Operand::preg(EAX), l);
+            func.emit(M_CDQ);
+            func.emit(M_IDIV, r);
+            func.emit(M_MOV, dest, Operand::preg(inst.op == IR_DIV ? EAX : EDX));
+            break;
+        case IR_SHL:
+        case IR_SAR:
+            if (r.isImm())
+            {
+                r = Operand::imm(r.value & 31);
+            }
+            else
+            {
+                func.emit(M_MOV, Operand::preg(ECX), r);
+                r = Operand::preg(ECX);
+            }
+            if (l != dest)
+                func.emit(M_MOV, dest, l);
+            func.emit(inst.op == IR_SHL ? M_SAL : M_SAR, dest, r);
+            break;
+        case IR_NEG:
+        case IR_NOT:
+            if (l != dest)
+                func.emit(M_MOV, dest, l);
+            func.emit(inst.op == IR_NEG ? M_NEG : M_NOT, dest);
+            break;
+        case IR_CMP:
+            // dest = (l cc r) ? 1 : 0
+            func.emit(M_CMP, func.toReg(l), r);
+            func.emitCond(M_SETCC, condCode(inst.cmp));
+            func.emit(M_MOVZX, dest);
+            break;
+        case IR_CALL:
+            genCall(inst);
+            break;
+        case IR_JMP:
+            if (inst.target != block.id + 1)
+                func.emit(M_JMP, Operand::label(label(inst.target)));
+            break;
+        case IR_BR:
+            genBranch(block, inst);
+            break;
+        case IR_RET:
+            if (!inst.a.isNone())
+                func.emit(M_MOV, Operand::preg(EAX), l);
+            func.emit(M_RET);
+            break;
+        case IR_TAILCALL:
+            genTailCall(inst);
+            break;
+        }
+    }
+
+    // dest = l op r，x86的运算指令是双地址的，需要先把左操作数放到dest中
+    void genArithmetic(MOpcode opcode, const Operand &dest, Operand l, Operand r, bool commutative)
+    {
+        if (commutative && (r == dest || (l.isImm() && !r.isImm())))
+        {
+            std::swap(l, r);
+        }
+        if (r == dest && l != dest)
+        {
+            Operand temp = func.newVReg();
+            func.emit(M_MOV, temp, l);
+            func.emit(opcode, temp, r);
+            func.emit(M_MOV, dest, temp);
+            return;
+        }
+        if (l != dest)
+            func.emit(M_MOV, dest, l);
+        func.emit(opcode, dest, r);
+    }
+
+    // dest = x * c，c的绝对值是1、3、5、9乘以2的幂时用lea和移位代替imul
+    // 按32位补码计算，x * c与-(x * |c|)的结果完全相同，c为INT_MIN时也是如此
+    void genMulImm(const Operand &dest, const Operand &x, int c)
+    {
+        unsigned m = c < 0 ? 0u - (unsigned)c : (unsigned)c;
+        int shift = 0;
+        while (m != 0 && (m & 1) == 0)
+        {
+            m >>= 1;
+            shift++;
+        }
+        if (c == 0)
+        {
+            func.emit(M_MOV, dest, Operand::imm(0));
+            return;
+        }
+        if (m != 1 && m != 3 && m != 5 && m != 9)
+        {
+            genArithmetic(M_IMUL, dest, x, Operand::imm(c), true);
+            return;
+        }
+        if (m == 1)
+        {
+            if (x != dest)
+                func.emit(M_MOV, dest, x);
+        }
+        else
+        {
+            func.emit(M_LEA, dest, x);
+            func.insts.back().scale = m - 1;
+        }
+        if (shift != 0)
+            func.emit(M_SAL, dest, Operand::imm(shift));
+        if (c < 0)
+            func.emit(M_NEG, dest);
+    }
+
+    // dest = x / d或x % d，结果与idiv完全相同（商向零取整，余数与被除数同号）
+    // d为0、-1和INT_MIN时返回false，仍然使用idiv，除零和溢出照常触发异常
+    bool genDivImm(const Operand &dest, const Operand &x, int d, bool isMod)
+    {
+        if (d == 0 || d == -1 || d == INT_MIN)
+            return false;
+        unsigned ad = d < 0 ? 0u - (unsigned)d : (unsigned)d;
+        if (ad == 1)
+        {
+            func.emit(M_MOV, dest, isMod ? Operand::imm(0) : x);
+            if (!isMod && d < 0)
+                func.emit(M_NEG, dest);
+            return true;
+        }
+        if ((ad & (ad - 1)) == 0)
+            genDivPow2(dest, x, d, ad, isMod);
+        else
+            genDivMagic(dest, x, d, isMod);
+        return true;
+    }
+
+    // 除以2的k次幂：算术右移向负无穷取整，被除数为负时先加上2^k-1
+    // 余数：((x + bias) & (2^k-1)) - bias，bias在x为负时是2^k-1，否则是0
+    void genDivPow2(const Operand &dest, const Operand &x, int d, unsigned ad, bool isMod)
+    {
+        int k = 0;
+        while ((1u << k) != ad)
+            k++;
+        Operand bias = func.newVReg();
+        func.emit(M_MOV, bias, x);
+        if (k > 1)
+            func.emit(M_SAR, bias, Operand::imm(31));
+        func.emit(M_SHR, bias, Operand::imm(32 - k));
+        Operand t = func.newVReg();
+        func.emit(M_MOV, t, x);
+        func.emit(M_ADD, t, bias);
+        if (isMod)
+        {
+            // x % -d与x % d相同
+            func.emit(M_AND, t, Operand::imm(ad - 1));
+            func.emit(M_SUB, t, bias);
+        }
+        else
+        {
+            func.emit(M_SAR, t, Operand::imm(k));
+            if (d < 0)
+                func.emit(M_NEG, t);
+        }
+        func.emit(M_MOV, dest, t);
+    }
+
+    // 除以其他常数：乘以magic number取高32位再移位，最后加上符号位使商向零取整
+    // 见Hacker's Delight第10章，余数由x - q * d得到
+    void genDivMagic(const Operand &dest, const Operand &x, int d, bool isMod)
+    {
+        int magic, shift;
+        magicNumber(d, magic, shift);
+        func.emit(M_MOV, Operand::preg(EAX), Operand::imm(magic));
+        func.emit(M_IMULH, x);
+        Operand q = func.newVReg();
+        func.emit(M_MOV, q, Operand::preg(EDX));
+        if (d > 0 && magic < 0)
+            func.emit(M_ADD, q, x);
+        else if (d < 0 && magic > 0)
+            func.emit(M_SUB, q, x);
+        if (shift != 0)
+            func.emit(M_SAR, q, Operand::imm(shift));
+        Operand sign = func.newVReg();
+        func.emit(M_MOV, sign, q);
+        func.emit(M_SHR, sign, Operand::imm(31));
+        func.emit(M_ADD, q, sign);
+        if (!isMod)
+        {
+            func.emit(M_MOV, dest, q);
+            return;
+        }
+        Operand product = func.newVReg();
+        genMulImm(product, q, d);
+        Operand r = func.newVReg();
+        func.emit(M_MOV, r, x);
+        func.emit(M_SUB, r, product);
+        func.emit(M_MOV, dest, r);
+    }
+
+    // 有符号除法的magic number，d不能是0、1、-1和2的幂
+    static void magicNumber(int d, int &magic, int &shift)
+    {
+        const unsigned two31 = 0x80000000u;
+        unsigned ad = d < 0 ? 0u - (unsigned)d : (unsigned)d;
+        unsigned t = two31 + ((unsigned)d >> 31);
+        unsigned anc = t - 1 - t % ad; // |nc|
+        int p = 31;
+        unsigned q1 = two31 / anc, r1 = two31 - q1 * anc;
+        unsigned q2 = two31 / ad, r2 = two31 - q2 * ad;
+        unsigned delta;
+        do
+        {
+            p++;
+            q1 = 2 * q1;
+            r1 = 2 * r1;
+            if (r1 >= anc)
+            {
+                q1++;
+                r1 -= anc;
+            }
+            q2 = 2 * q2;
+            r2 = 2 * r2;
+            if (r2 >= ad)
+            {
+                q2++;
+                r2 -= ad;
+            }
+            delta = ad - r2;
+        } while (q1 < delta || (q1 == delta && r1 == 0));
+        magic = (int)(q2 + 1);
+        if (d < 0)
+            magic = (int)(0u - (unsigned)magic);
+        shift = p - 32;
+    }
+
+    void genCall(const IRInst &inst)
+    {
+        if (isX86_64())
+        {
+            genCall64(inst);
+            return;
+        }
+        bool isPrint = inst.callee->id == PRINT_SYMBOL_ID;
+        int bytes = (inst.args.size() + (isPrint ? 1 : 0)) * 4;
+        bytes += func.alignCall(bytes);
+
+        // 函数参数倒着入栈
+        for (auto it = inst.args.rbegin(); it != inst.args.rend(); it++)
+        {
+            func.emit(M_PUSH, operand(*it));
+            func.stackDepth += 4;
+        }
+        if (isPrint)
+        {
+            func.emit(M_PUSH, Operand::symbol("format_str"));
+            func.stackDepth += 4;
+            func.emit(M_CALL, Operand::symbol("printf"));
+        }
+        else
+        {
+            func.emit(M_CALL, Operand::symbol(asmName(inst.callee)));
+        }
+        if (bytes != 0)
+            func.emit(M_ADD, Operand::preg(ESP), Operand::imm(bytes));
+        func.stackDepth -= bytes;
+        func.emit(M_MOV, operand(inst.dst), Operand::preg(EAX));
+    }
+
+    // System V调用约定：前6个实参放入rdi、rsi、rdx、rcx、r8、r9，之后的倒着入栈，每个8字节
+    // printf是可变参数的函数，al中是通过向量寄存器传递的参数个数
+    void genCall64(const IRInst &inst)
+    {
+        bool isPrint = inst.callee->id == PRINT_SYMBOL_ID;
+        std::vector<Operand> args;
+        if (isPrint)
+            args.push_back(Operand()); // 格式字符串的地址，单独用lea取得
+        for (auto it = inst.args.begin(); it != inst.args.end(); it++)
+            args.push_back(operand(*it));
+
+        int regArgs = std::min((int)args.size(), ARG_REG_NUM);
+        int bytes = ((int)args.size() - regArgs) * 8;
+        bytes += func.alignCall(bytes);
+        for (int i = (int)args.size() - 1; i >= regArgs; i--)
+        {
+            func.emit(M_PUSH, args[i]);
+            func.stackDepth += 8;
+        }
+        for (int i = 0; i < regArgs; i++)
+        {
+            if (isPrint && i == 0)
+                func.emit(M_LEA, Operand::preg(ARG_REGS[i]), Operand::symbol("format_str"));
+            else
+                func.emit(M_MOV, Operand::preg(ARG_REGS[i]), args[i]);
+        }
+        if (isPrint)
+        {
+            func.emit(M_MOV, Operand::preg(EAX), Operand::imm(0));
+            func.emit(M_CALL, Operand::symbol("printf@PLT"));
+            func.insts.back().variadic = true;
+        }
+        else
+        {
+            func.emit(M_CALL, Operand::symbol(asmName(inst.callee)));
+        }
+        func.insts.back().regArgs = regArgs;
+        if (bytes != 0)
+            func.emit(M_ADD, Operand::preg(ESP), Operand::imm(bytes));
+        func.stackDepth -= bytes;
+        func.emit(M_MOV, operand(inst.dst), Operand::preg(EAX));
+    }
+
+    // 通过栈传递的实参覆盖本函数的参数所在的栈单元，释放栈帧后跳到被调用的函数
+    // 参数在函数开头已经读入虚拟寄存器，覆盖栈单元不影响后面的实参
+    // x86-64下其余的实参放入传递参数的寄存器，它们都是调用者保存寄存器，恢复被调用者保存寄存器时不受影响
+    void genTailCall(const IRInst &inst)
+    {
+        int regArgs = isX86_64() ? std::min((int)inst.args.size(), ARG_REG_NUM) : 0;
+        for (size_t i = regArgs; i < inst.args.size(); i++)
+        {
+            // 原样传递的参数没有被修改过时，栈单元中已经是这个值
+            if (inst.args[i] == IRValue::vreg(i) && !paramAssigned(i))
+                continue;
+            func.emit(M_MOV, paramLocation(i), operand(inst.args[i]));
+        }
+        for (int i = 0; i < regArgs; i++)
+        {
+            func.emit(M_MOV, Operand::preg(ARG_REGS[i]), operand(inst.args[i]));
+        }
+        func.emit(M_TAILJMP, Operand::symbol(asmName(inst.callee)));
+        func.insts.back().regArgs = regArgs;
+    }
+
+    // 比较后条件跳转，只对不能顺序执行到的一边生成跳转
+    void genBranch(const IRBlock &block, const IRInst &inst)
+    {
+        CondCode cc = condCode(inst.cmp);
+        Operand l = operand(inst.a);
+        Operand r = operand(inst.b);
+        if (l.isImm() && !r.isImm())
+        {
+            // cmp的第一个操作数不能是立即数，交换操作数代替多用一个寄存器
+            std::swap(l, r);
+            cc = swapCondCode(cc);
+        }
+        if (r.isImm() && r.value == 0 && l.isVReg())
+            func.emit(M_TEST, l, l);
+        else
+            func.emit(M_CMP, func.toReg(l), r);
+
+        int next = block.id + 1;
+        if (inst.target == next)
+        {
+            func.emitCond(M_JCC, invertCondCode(cc), Operand::label(label(inst.falseTarget)));
+            return;
+        }
+        func.emitCond(M_JCC, cc, Operand::label(label(inst.target)));
+        if (inst.falseTarget != next)
+            func.emit(M_JMP, Operand::label(label(inst.falseTarget)));
+    }
+};
+
+#endif
@@ -0,0 +1,456 @@
+#ifndef __X86ENCODER_H__
+#define __X86ENCODER_H__
+
+#include <initializer_list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AsmCode.h"
+#include "MachineCode.h"
+
+// x86机器码编码器：把寄存器分配和窥孔优化之后的AsmFunction编码为机器码，与print输出的汇编代码逐条对应
+// 函数内的跳转先按rel8编码，偏移放不下时改为rel32，反复调整直到所有跳转的长度都确定
+class X86Encoder
+{
+public:
+    X86Encoder(const AsmFunction &func) : func(func), x86_64(func.target == TARGET_X86_64) {}
+
+    void encode(MachineCode &code)
+    {
+        pieces.clear();
+        labelPieces.clear();
+        encodePrologue();
+        for (auto it = func.insts.begin(); it != func.insts.end(); it++)
+        {
+            encodeInst(*it);
+        }
+        for (auto it = pieces.begin(); it != pieces.end(); it++)
+        {
+            if (it->jump)
+                it->targetPiece = labelPieces.at(it->target);
+        }
+
+        // 跳转只会变长，一定能到达不动点
+        std::vector<int> offsets;
+        bool changed = true;
+        while (changed)
+        {
+            changed = false;
+            layout(offsets);
+            for (size_t i = 0; i < pieces.size(); i++)
+            {
+                Piece &p = pieces[i];
+                if (p.jump && !p.longForm && !isInt8(offsets[p.targetPiece] - (offsets[i] + 2)))
+                {
+                    p.longForm = true;
+                    changed = true;
+                }
+            }
+        }
+
+        code.name = func.name;
+        code.bytes.clear();
+        code.bytes.reserve(offsets.back());
+        code.relocs.clear();
+        for (size_t i = 0; i < pieces.size(); i++)
+        {
+            const Piece &p = pieces[i];
+            for (auto it = p.relocs.begin(); it != p.relocs.end(); it++)
+            {
+                code.relocs.push_back(*it);
+                code.relocs.back().offset += offsets[i];
+            }
+            code.bytes += p.bytes;
+            if (p.jump)
+                encodeJump(code.bytes, p, offsets[p.targetPiece] - offsets[i + 1]);
+        }
+    }
+
+private:
+    // 一条指令的编码；跳转的偏移在所有指令的位置确定之后才填写
+    struct Piece
+    {
+        std::string bytes;
+        std::vector<Relocation> relocs; // offset相对于这条指令的开头
+        bool jump = false;
+        int cc = -1;          // 条件跳转的条件码，-1为jmp
+        std::string target;   // 跳转目标的标签
+        int targetPiece = -1; // 跳转目标的标签所在的下标
+        bool longForm = false;
+    };
+
+    const AsmFunction &func;
+    bool x86_64;
+    std::vector<Piece> pieces;
+    std::map<std::string, int> labelPieces; // 标签所在的下标，标签本身是一个空的Piece
+
+    static bool isInt8(int value)
+    {
+        return value >= -128 && value <= 127;
+    }
+
+    static void put8(std::string &out, int value)
+    {
+        out.push_back((char)(value & 0xff));
+    }
+
+    static void put32(std::string &out, int value)
+    {
+        for (int i = 0; i < 4; i++)
+            put8(out, (int)((unsigned)value >> (8 * i)));
+    }
+
+    static void putImm(std::string &out, int value, bool byte)
+    {
+        if (byte)
+            put8(out, value);
+        else
+            put32(out, value);
+    }
+
+    // 寄存器在指令编码中的编号
+    static int hw(int reg)
+    {
+        static const int numbers[] = {0, 3, 1, 2, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 4, 5};
+        return numbers[reg];
+    }
+
+    // 条件码在jcc、setcc中的编号
+    static int ccCode(CondCode cc)
+    {
+        static const int codes[] = {0x4, 0x5, 0xC, 0xE, 0xF, 0xD};
+        return codes[cc];
+    }
+
+    // REX前缀：W为64位操作数，R、X、B分别扩展ModRM.reg、SIB.index和ModRM.rm或SIB.base
+    // 32位时不会用到r8~r15和64位操作数，不会输出
+    static void rex(std::string &out, bool wide, int reg, int index, int base)
+    {
+        int bits = (wide ? 8 : 0) | (reg >= 8 ? 4 : 0) | (index >= 8 ? 2 : 0) | (base >= 8 ? 1 : 0);
+        if (bits != 0)
+            put8(out, 0x40 | bits);
+    }
+
+    // ModRM寻址的指令：reg是寄存器的编号或操作码扩展，rm是寄存器或[ebp+offset]
+    static void emitRM(Piece &p, bool wide, std::initializer_list<int> opcode, int reg, const Operand &rm)
+    {
+        std::string &out = p.bytes;
+        int base = rm.kind == OPD_PREG ? hw(rm.value) : hw(EBP);
+        rex(out, wide, reg, 0, base);
+        for (int byte : opcode)
+            put8(out, byte);
+        if (rm.kind == OPD_PREG)
+        {
+            put8(out, 0xC0 | (reg & 7) << 3 | (base & 7));
+        }
+        else if (isInt8(rm.value))
+        {
+            put8(out, 0x40 | (reg & 7) << 3 | (base & 7));
+            put8(out, rm.value);
+        }
+        else
+        {
+            put8(out, 0x80 | (reg & 7) << 3 | (base & 7));
+            put32(out, rm.value);
+        }
+    }
+
+    // 外部符号在汇编代码中可能带有@PLT，重定位时只用符号名
+    static std::string symbolName(const std::string &name)
+    {
+        size_t at = name.find('@');
+        return at == std::string::npos ? name : name.substr(0, at);
+    }
+
+    void addReloc(Piece &p, const std::string &symbol, RelocKind kind)
+    {
+        p.relocs.push_back(Relocation{(int)p.bytes.size(), symbolName(symbol), kind});
+        put32(p.bytes, 0);
+    }
+
+    // 与AsmFunction::print输出的序言相同
+    void encodePrologue()
+    {
+        pieces.push_back(Piece());
+        Piece &p = pieces.back();
+        put8(p.bytes, 0x50 | hw(EBP));
+        emitRM(p, x86_64, {0x89}, hw(ESP), Operand::preg(EBP));
+        int bytes = func.frameBytes();
+        if (bytes != 0)
+        {
+            emitRM(p, x86_64, {isInt8(bytes) ? 0x83 : 0x81}, 5, Operand::preg(ESP));
+            putImm(p.bytes, bytes, isInt8(bytes));
+        }
+        for (auto it = func.savedRegs.begin(); it != func.savedRegs.end(); it++)
+        {
+            emitRM(p, x86_64, {0x89}, hw(it->first), Operand::mem(it->second));
+        }
+    }
+
+    // 恢复被调用者保存寄存器后leave
+    void encodeEpilogue(Piece &p)
+    {
+        for (auto it = func.savedRegs.begin(); it != func.savedRegs.end(); it++)
+        {
+            emitRM(p, x86_64, {0x8B}, hw(it->first), Operand::mem(it->second));
+        }
+        put8(p.bytes, 0xC9);
+    }
+
+    void encodeInst(const MInst &inst)
+    {
+        const Operand &a = inst.a;
+        const Operand &b = inst.b;
+        if (inst.op == M_LABEL)
+        {
+            labelPieces[a.name] = pieces.size();
+            pieces.push_back(Piece());
+            return;
+        }
+        pieces.push_back(Piece());
+        Piece &p = pieces.back();
+        switch (inst.op)
+        {
+        case M_MOV:
+            if (b.isImm() && a.kind == OPD_PREG)
+            {
+                rex(p.bytes, false, 0, 0, hw(a.value));
+                put8(p.bytes, 0xB8 | (hw(a.value) & 7));
+                put32(p.bytes, b.value);
+            }
+            else if (b.isImm())
+            {
+                emitRM(p, false, {0xC7}, 0, a);
+                put32(p.bytes, b.value);
+            }
+            else if (b.kind == OPD_PREG)
+            {
+                emitRM(p, false, {0x89}, hw(b.value), a);
+            }
+            else
+            {
+                emitRM(p, false, {0x8B}, hw(a.value), b);
+            }
+            break;
+        case M_LEA:
+            encodeLea(p, inst);
+            break;
+        case M_ADD:
+        case M_SUB:
+        case M_AND:
+        case M_OR:
+        case M_XOR:
+        case M_CMP:
+            encodeArithmetic(p, inst);
+            break;
+        case M_IMUL:
+            if (b.isImm())
+            {
+                emitRM(p, false, {isInt8(b.value) ? 0x6B : 0x69}, hw(a.value), a);
+                putImm(p.bytes, b.value, isInt8(b.value));
+            }
+            else
+            {
+                emitRM(p, false, {0x0F, 0xAF}, hw(a.value), b);
+            }
+            break;
+        case M_NEG:
+            emitRM(p, false, {0xF7}, 3, a);
+            break;
+        case M_NOT:
+            emitRM(p, false, {0xF7}, 2, a);
+            break;
+        case M_IDIV:
+            emitRM(p, false, {0xF7}, 7, a);
+            break;
+        case M_IMULH:
+            emitRM(p, false, {0xF7}, 5, a);
+            break;
+        case M_SAL:
+        case M_SAR:
+        case M_SHR:
+        {
+            int digit = inst.op == M_SAL ? 4 : inst.op == M_SAR ? 7 : 5;
+            if (!b.isImm())
+            {
+                emitRM(p, false, {0xD3}, digit, a); // 移位次数在cl中
+            }
+            else if (b.value == 1)
+            {
+                emitRM(p, false, {0xD1}, digit, a);
+            }
+            else
+            {
+                emitRM(p, false, {0xC1}, digit, a);
+                put8(p.bytes, b.value);
+            }
+            break;
+        }
+        case M_TEST:
+            if (b.kind == OPD_PREG)
+                emitRM(p, false, {0x85}, hw(b.value), a);
+            else
+                emitRM(p, false, {0x85}, hw(a.value), b);
+            break;
+        case M_SETCC:
+            emitRM(p, false, {0x0F, 0x90 | ccCode(inst.cc)}, 0, Operand::preg(EAX));
+            break;
+        case M_MOVZX:
+            emitRM(p, false, {0x0F, 0xB6}, hw(a.value), Operand::preg(EAX));
+            break;
+        case M_CDQ:
+            put8(p.bytes, 0x99);
+            break;
+        case M_PUSH:
+            if (a.kind == OPD_PREG)
+            {
+                rex(p.bytes, false, 0, 0, hw(a.value));
+                put8(p.bytes, 0x50 | (hw(a.value) & 7));
+            }
+            else if (a.isImm())
+            {
+                put8(p.bytes, isInt8(a.value) ? 0x6A : 0x68);
+                putImm(p.bytes, a.value, isInt8(a.value));
+            }
+            else if (a.kind == OPD_SYMBOL)
+            {
+                put8(p.bytes, 0x68);
+                addReloc(p, a.name, RELOC_ABS32);
+            }
+            else
+            {
+                emitRM(p, false, {0xFF}, 6, a);
+            }
+            break;
+        case M_CALL:
+            put8(p.bytes, 0xE8);
+            addReloc(p, a.name, x86_64 ? RELOC_PLT32 : RELOC_PC32);
+            break;
+        case M_JMP:
+        case M_JCC:
+            p.jump = true;
+            p.cc = inst.op == M_JCC ? ccCode(inst.cc) : -1;
+            p.target = a.name;
+            break;
+        case M_RET:
+            encodeEpilogue(p);
+            put8(p.bytes, 0xC3);
+            break;
+        case M_TAILJMP:
+            encodeEpilogue(p);
+            put8(p.bytes, 0xE9);
+            addReloc(p, a.name, x86_64 ? RELOC_PLT32 : RELOC_PC32);
+            break;
+        default:
+            break;
+        }
+    }
+
+    // add、sub、and、or、xor、cmp：立即数用/digit形式，否则按寄存器在哪一边选择操作码
+    // x86-64下调整rsp时是64位的
+    void encodeArithmetic(Piece &p, const MInst &inst)
+    {
+        int digit, toRM, toReg;
+        switch (inst.op)
+        {
+        case M_ADD:
+            digit = 0, toRM = 0x01, toReg = 0x03;
+            break;
+        case M_OR:
+            digit = 1, toRM = 0x09, toReg = 0x0B;
+            break;
+        case M_AND:
+            digit = 4, toRM = 0x21, toReg = 0x23;
+            break;
+        case M_SUB:
+            digit = 5, toRM = 0x29, toReg = 0x2B;
+            break;
+        case M_XOR:
+            digit = 6, toRM = 0x31, toReg = 0x33;
+            break;
+        default:
+            digit = 7, toRM = 0x39, toReg = 0x3B;
+            break;
+        }
+        const Operand &a = inst.a;
+        const Operand &b = inst.b;
+        bool wide = x86_64 && a.isPReg(ESP);
+        if (b.isImm())
+        {
+            emitRM(p, wide, {isInt8(b.value) ? 0x83 : 0x81}, digit, a);
+            putImm(p.bytes, b.value, isInt8(b.value));
+        }
+        else if (b.kind == OPD_PREG)
+        {
+            emitRM(p, wide, {toRM}, hw(b.value), a);
+        }
+        else
+        {
+            emitRM(p, wide, {toReg}, hw(a.value), b);
+        }
+    }
+
+    // lea a, [b+b*scale]，或x86-64下的lea a, [rip+symbol]
+    void encodeLea(Piece &p, const MInst &inst)
+    {
+        int reg = hw(inst.a.value);
+        if (inst.b.kind == OPD_SYMBOL)
+        {
+            rex(p.bytes, true, reg, 0, 0);
+            put8(p.bytes, 0x8D);
+            put8(p.bytes, (reg & 7) << 3 | 5);
+            addReloc(p, inst.b.name, RELOC_PC32);
+            return;
+        }
+        int base = hw(inst.b.value);
+        int scaleBits = inst.scale == 8 ? 3 : inst.scale == 4 ? 2 : inst.scale == 2 ? 1 : 0;
+        rex(p.bytes, false, reg, base, base);
+        put8(p.bytes, 0x8D);
+        // 基址是ebp或r13时没有不带偏移的形式，加上8位的偏移0
+        bool disp8 = (base & 7) == 5;
+        put8(p.bytes, (disp8 ? 0x44 : 0x04) | (reg & 7) << 3);
+        put8(p.bytes, scaleBits << 6 | (base & 7) << 3 | (base & 7));
+        if (disp8)
+            put8(p.bytes, 0);
+    }
+
+    static int jumpSize(const Piece &p)
+    {
+        if (!p.longForm)
+            return 2;
+        return p.cc < 0 ? 5 : 6;
+    }
+
+    // offsets[i]是第i条指令的开头，offsets.back()是整个函数的长度
+    void layout(std::vector<int> &offsets) const
+    {
+        offsets.assign(pieces.size() + 1, 0);
+        for (size_t i = 0; i < pieces.size(); i++)
+        {
+            offsets[i + 1] = offsets[i] + pieces[i].bytes.size() + (pieces[i].jump ? jumpSize(pieces[i]) : 0);
+        }
+    }
+
+    static void encodeJump(std::string &out, const Piece &p, int disp)
+    {
+        if (!p.longForm)
+        {
+            put8(out, p.cc < 0 ? 0xEB : 0x70 | p.cc);
+            put8(out, disp);
+        }
+        else if (p.cc < 0)
+        {
+            put8(out, 0xE9);
+            put32(out, disp);
+        }
+        else
+        {
+            put8(out, 0x0F);
+            put8(out, 0x80 | p.cc);
+            put32(out, disp);
+        }
+    }
+};
+
+#endif
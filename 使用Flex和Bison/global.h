@@ -2,70 +2,80 @@
 #define __GLOBAL_H__
 
 #include <vector>
+#include <string>
+#include <sys/types.h>
+
+#include "Symbol.h"
 
 struct IdentifierItem
 {
-    std::string name;
-    ssize_t offset;
+    const Symbol *symbol;
+    int slot;  // 变量在函数中的编号，代码生成时就是它所在的虚拟寄存器
+    int scope; // 声明所在的作用域层数
 };
 
+// 带嵌套作用域的标识符表，按名字查找时得到最内层可见的声明
 class IdentifierTable
 {
 private:
-    std::vector<IdentifierItem> items;
-    ssize_t ebpOffset = 0;
+    std::vector<IdentifierItem> items;           // 当前可见的声明，离开作用域时从末尾弹出
+    std::vector<std::vector<size_t>> bindings; // 按Symbol编号索引，同名声明下标的栈，栈顶是最内层的
+    std::vector<size_t> scopeStarts;           // 每层作用域中第一个声明的下标
 
 public:
-    // 向table中添加元素，如果元素已经存在，则直接返回其下标
-    size_t add(const std::string &name)
+    void enterScope()
     {
-        auto index = find(name);
-        if (index == -1)
+        scopeStarts.push_back(items.size());
+    }
+
+    // 离开作用域，丢弃其中的声明
+    void exitScope()
+    {
+        size_t start = scopeStarts.back();
+        scopeStarts.pop_back();
+        while (items.size() > start)
         {
-            IdentifierItem item;
-            item.name = std::string(name);
-            ebpOffset -= 4;
-            item.offset = ebpOffset;
-            items.push_back(item);
+            bindings[items.back().symbol->id].pop_back();
+            items.pop_back();
         }
-
-        return index;
     }
 
-    // 向table中添加元素，如果元素已经存在，则直接返回其下标
-    size_t add(const std::string &name, int offset)
+    // 在当前作用域中添加声明，返回其下标；同一作用域中已经有同名声明时返回-1
+    ssize_t add(const Symbol *symbol, int slot)
     {
-        auto index = find(name);
-        if (index == -1)
+        if (symbol->id >= (int)bindings.size())
         {
-            IdentifierItem item;
-            item.name = std::string(name);
-            item.offset = offset;
-            items.push_back(item);
+            bindings.resize(symbol->id + 1);
         }
-
-        return index;
+        std::vector<size_t> &stack = bindings[symbol->id];
+        if (!stack.empty() && items[stack.back()].scope == (int)scopeStarts.size())
+        {
+            return -1;
+        }
+        IdentifierItem item;
+        item.symbol = symbol;
+        item.slot = slot;
+        item.scope = scopeStarts.size();
+        stack.push_back(items.size());
+        items.push_back(item);
+        return items.size() - 1;
     }
 
-    ssize_t find(const std::string &name)
+    ssize_t find(const Symbol *symbol) const
     {
-        for (auto it = items.begin(); it != items.end(); it++)
+        if (symbol->id >= (int)bindings.size() || bindings[symbol->id].empty())
         {
-            if (it->name == name)
-            {
-                return std::distance(items.begin(), it);
-            }
+            return -1;
         }
-
-        return -1;
+        return bindings[symbol->id].back();
     }
 
-    IdentifierItem get(size_t index)
+    const IdentifierItem &get(size_t index) const
     {
         return items.at(index);
     }
 
-    size_t size()
+    size_t size() const
     {
         return items.size();
     }
@@ -73,10 +83,37 @@ public:
     void clear()
     {
         items.clear();
-        ebpOffset = 0;
+        bindings.clear();
+        scopeStarts.clear();
     }
 };
 
+// 目标平台
+enum Target
+{
+    TARGET_I386,   // 32位x86，cdecl调用约定，参数全部通过栈传递
+    TARGET_X86_64, // x86-64，System V调用约定，前6个参数通过寄存器传递
+};
+
+// 编译选项
+struct CompilerOptions
+{
+    bool printStats = false;     // 向标准错误输出各个优化阶段的统计信息
+    bool dumpIR = false;         // 向标准错误输出每个函数的IR
+    Target target = TARGET_I386; // -m32或-m64
+    bool emitObject = false;     // -c，直接输出ELF目标文件而不是汇编代码
+    bool jit = false;            // --jit，不输出代码，编译后在编译器的进程中直接运行
+    bool vm = false;             // --vm，不生成机器码，编译成字节码后在编译器的进程中解释执行
+
+    // 后端生成机器码而不是汇编代码
+    bool encodeMachineCode() const
+    {
+        return emitObject || jit;
+    }
+};
+
+extern CompilerOptions compilerOptions;
+
 // C语言中的变量类型
 enum CType
 {
@@ -1,49 +1,410 @@
 #include <iostream>
 #include <fstream>
 #include <string>
-#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <thread>
 #include <cstdlib>
 #include <cstdio>
 
+#include <fcntl.h>
+#include <unistd.h>
+
 #include "global.h"
 #include "ASTNodes.h"
+#include "NameResolver.h"
+#include "ConstantFolder.h"
+#include "CompilationContext.h"
+#include "IRGenerator.h"
+#include "IRVerifier.h"
+#include "DeadCodeEliminator.h"
+#include "TailCallEliminator.h"
+#include "Inliner.h"
+#include "LoopInvariantCodeMotion.h"
+#include "X86Backend.h"
+#include "ElfWriter.h"
+#include "Jit.h"
+#include "BytecodeCompiler.h"
+#include "BytecodeVM.h"
 
 using namespace std;
 
-extern shared_ptr<NBlock> programBlock;
+CompilerOptions compilerOptions;
 
-extern int yyparse();
-extern FILE *yyin;
+extern int yyparse(void *scanner, CompilationContext &context);
+extern bool beginScan(CompilationContext &context);
+extern void endScan(CompilationContext &context);
 
-int main(int argc, char *argv[])
+// 生成一个函数的IR，做只涉及这个函数自身的优化；结果供之后内联到其他函数中
+static IRFunction lowerFunction(const NFunctionDefine *funcDef, std::ostream &diagnostics)
 {
-    string sourceFileName = argv[1];
-    // string sourceFileName = "./input.txt";
-    if ((yyin = fopen(sourceFileName.c_str(), "r")) == nullptr)
+    IRFunction ir = IRGenerator().generate(funcDef);
+    IRVerifier(ir, diagnostics).verify();
+
+    DeadCodeEliminator dce(ir);
+    dce.run();
+    TailCallEliminator tce(ir);
+    tce.run();
+    if (tce.recursionNum + tce.tailCallNum > 0)
+    {
+        dce.run(); // 变成尾调用之后，原来调用之后的返回可能不再可达
+    }
+    IRVerifier(ir, diagnostics).verify();
+    if (compilerOptions.printStats)
+    {
+        diagnostics << "[dce] " << ir.symbol->name << ": " << dce.removedInstNum << " instructions, "
+                    << dce.removedBlockNum << " blocks removed" << endl;
+        diagnostics << "[tailcall] " << ir.symbol->name << ": " << tce.recursionNum << " recursive calls turned into loops, "
+                    << tce.tailCallNum << " tail calls" << endl;
+    }
+    return ir;
+}
+
+// 内联其他函数，继续优化，最后交给x86后端；每一步之后检查IR
+// 汇编代码写到out，输出目标文件时机器码写到code
+static void compileFunction(IRFunction ir, const std::unordered_map<const Symbol *, const IRFunction *> &functions,
+                            AsmWriter &out, MachineCode &code, std::ostream &diagnostics)
+{
+    Inliner inliner(ir, functions);
+    inliner.run();
+    if (inliner.inlinedNum > 0)
+    {
+        DeadCodeEliminator(ir).run();
+    }
+    IRVerifier(ir, diagnostics).verify();
+    if (compilerOptions.printStats)
     {
-        cerr << "源文件无法打开" << endl;
+        diagnostics << "[inline] " << ir.symbol->name << ": " << inliner.inlinedNum << " calls inlined ("
+                    << inliner.inlinedCost << " instructions)" << endl;
+    }
+
+    LoopInvariantCodeMotion licm(ir);
+    licm.run();
+    IRVerifier(ir, diagnostics).verify();
+    if (compilerOptions.printStats)
+    {
+        diagnostics << "[licm] " << ir.symbol->name << ": " << licm.hoistedNum << " instructions hoisted out of "
+                    << licm.loopNum << " loops" << endl;
+    }
+
+    if (compilerOptions.dumpIR)
+    {
+        ir.dump(diagnostics);
+    }
+    X86Backend backend(ir);
+    backend.generate(diagnostics);
+    if (compilerOptions.encodeMachineCode())
+    {
+        backend.encode(code);
+    }
+    else
+    {
+        backend.print(out);
+    }
+}
+
+// 为所有函数生成代码，每个函数是一个任务，分两轮并行：
+// 第一轮生成各个函数的IR；第二轮每个函数在自己的副本上内联其他函数并生成代码，第一轮的结果只读、各任务共享
+// 每个函数写到自己的缓冲区中，全部完成后按源代码中的顺序拼接，输出与逐个生成时完全相同
+// 生成机器码时各个函数的机器码按同样的顺序放在context.functions中
+static void genProgram(CompilationContext &context)
+{
+    std::vector<const NFunctionDefine *> funcDefs;
+    for (auto it = context.program->statements.begin(); it != context.program->statements.end(); it++)
+    {
+        auto funcDef = dynamic_cast<const NFunctionDefine *>(*it);
+        if (funcDef != nullptr)
+        {
+            funcDefs.push_back(funcDef);
+        }
+    }
+
+    std::vector<IRFunction> lowered(funcDefs.size());
+    std::vector<AsmWriter> outs;
+    std::vector<std::ostringstream> diagnostics(funcDefs.size());
+    outs.reserve(funcDefs.size());
+    for (size_t i = 0; i < funcDefs.size(); i++)
+    {
+        outs.emplace_back(compilerOptions.encodeMachineCode() ? 0 : 16 * 1024);
+    }
+    context.functions.resize(funcDefs.size());
+    context.pool->parallelFor(funcDefs.size(), [&](size_t i)
+                              { lowered[i] = lowerFunction(funcDefs[i], diagnostics[i]); });
+
+    std::unordered_map<const Symbol *, const IRFunction *> functions;
+    for (auto it = lowered.begin(); it != lowered.end(); it++)
+    {
+        functions[it->symbol] = &*it;
+    }
+    context.pool->parallelFor(funcDefs.size(), [&](size_t i)
+                              { compileFunction(lowered[i], functions, outs[i], context.functions[i], diagnostics[i]); });
+
+    for (size_t i = 0; i < funcDefs.size(); i++)
+    {
+        context.out << outs[i].str();
+        context.diagnostics << diagnostics[i].str();
+    }
+}
+
+// 编译一个源文件，汇编代码或目标文件留在context.out中，错误和统计信息留在context.diagnostics中
+// 返回值与单独编译这个文件时进程的退出码相同
+static int compile(CompilationContext &context)
+{
+    // 源文件映射到内存中，词法分析直接扫描映射
+    if (!context.source.open(context.sourceFileName) || !beginScan(context))
+    {
+        context.diagnostics << "源文件无法打开" << endl;
         return 1;
     }
 
     // 构建语法树
-    if (yyparse()==1){
-        cerr << "Parser Error!" << endl;
+    int parseResult = yyparse(context.scanner, context);
+    endScan(context);
+    if (parseResult == 1)
+    {
+        context.diagnostics << "Parser Error!" << endl;
         return -1;
     }
 
-    cout << ".intel_syntax noprefix" << endl;
-    cout << ".global main" << endl;
-    cout << ".extern printf" << endl;
-    cout << ".data" << endl;
-    cout << "format_str:" << endl;
-    cout << "\t.asciz \"%d\\n\"" << endl;
-    cout << ".text" << endl;
+    NodeArena &arena = context.arena;
+    if (compilerOptions.printStats)
+    {
+        context.diagnostics << "[ast] " << arena.getObjectNum() << " objects, " << arena.getUsedBytes() << " bytes in "
+                            << arena.getChunkNum() << " chunks (" << arena.getReservedBytes() << " bytes reserved)" << endl;
+    }
+
+    NameResolver resolver(context);
+    resolver.run(context.program);
+    if (compilerOptions.printStats)
+    {
+        context.diagnostics << "[resolve] " << context.symbols.size() << " distinct identifiers, " << resolver.boundNum << " references bound" << endl;
+    }
+    if (resolver.errorNum > 0)
+    {
+        return 1;
+    }
 
-    ostream &out = cout;
-    string prefix = "";
-    programBlock->genAsmCode(out, prefix);
+    ConstantFolder folder(arena);
+    folder.run(context.program);
+    if (compilerOptions.printStats)
+    {
+        context.diagnostics << "[constant] " << folder.foldedNum << " expressions folded, " << folder.propagatedNum << " variables propagated" << endl;
+    }
+
+    if (compilerOptions.vm)
+    {
+        BytecodeCompiler bytecodeCompiler(context.bytecode);
+        bytecodeCompiler.run(context.program);
+        if (compilerOptions.printStats)
+        {
+            context.diagnostics << "[bytecode] " << context.bytecode.functions.size() << " functions, " << bytecodeCompiler.instNum << " instructions" << endl;
+        }
+        if (context.bytecode.mainIndex == -1)
+        {
+            context.diagnostics << "没有main函数" << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (compilerOptions.encodeMachineCode())
+    {
+        genProgram(context);
+        if (compilerOptions.emitObject)
+        {
+            ElfWriter elf(compilerOptions.target);
+            for (auto it = context.functions.begin(); it != context.functions.end(); it++)
+            {
+                elf.addFunction(*it);
+            }
+            elf.write(context.out);
+        }
+        return 0;
+    }
+
+    AsmWriter &out = context.out;
+    out << ".intel_syntax noprefix\n";
+    out << ".global main\n";
+    out << ".extern printf\n";
+    out << ".data\n";
+    out << "format_str:\n";
+    out << "\t.asciz \"%d\\n\"\n";
+    out << ".text\n";
+    if (compilerOptions.target == TARGET_X86_64)
+    {
+        out << ".section .note.GNU-stack,\"\",@progbits\n"; // 不需要可执行的栈
+        out << ".text\n";
+    }
+
+    genProgram(context);
+    return 0;
+}
+
+// 多个源文件时，a.c的汇编代码写到a.s，目标文件写到a.o
+static string outputFileName(const string &sourceFileName)
+{
+    const char *extension = compilerOptions.emitObject ? ".o" : ".s";
+    size_t dot = sourceFileName.rfind('.');
+    size_t slash = sourceFileName.rfind('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash))
+    {
+        return sourceFileName + extension;
+    }
+    return sourceFileName.substr(0, dot) + extension;
+}
+
+static bool writeOutput(const CompilationContext &context, bool toStdout)
+{
+    if (toStdout)
+    {
+        return context.out.writeTo(STDOUT_FILENO);
+    }
+    int fd = open(outputFileName(context.sourceFileName).c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        return false;
+    }
+    bool written = context.out.writeTo(fd);
+    return close(fd) == 0 && written;
+}
+
+int main(int argc, char *argv[])
+{
+    vector<string> sourceFileNames;
+    // string sourceFileName = "./input.txt";
+    int jobNum = thread::hardware_concurrency();
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        if (arg == "--stats")
+        {
+            compilerOptions.printStats = true;
+        }
+        else if (arg == "--dump-ir")
+        {
+            compilerOptions.dumpIR = true;
+        }
+        else if (arg == "-c")
+        {
+            compilerOptions.emitObject = true;
+        }
+        else if (arg == "--jit")
+        {
+            compilerOptions.jit = true;
+            compilerOptions.vm = false;
+        }
+        else if (arg == "--vm")
+        {
+            compilerOptions.vm = true;
+            compilerOptions.jit = false;
+        }
+        else if (arg == "-m32")
+        {
+            compilerOptions.target = TARGET_I386;
+        }
+        else if (arg == "-m64")
+        {
+            compilerOptions.target = TARGET_X86_64;
+        }
+        else if (arg == "-j" && i + 1 < argc)
+        {
+            jobNum = atoi(argv[++i]);
+        }
+        else if (arg.compare(0, 2, "-j") == 0 && arg.size() > 2)
+        {
+            jobNum = atoi(arg.c_str() + 2);
+        }
+        else
+        {
+            sourceFileNames.push_back(arg);
+        }
+    }
+    if (sourceFileNames.empty())
+    {
+        sourceFileNames.push_back("");
+    }
+    if (jobNum < 1)
+    {
+        jobNum = 1;
+    }
+    // 即时编译生成的代码在编译器所在的平台上运行
+    if (compilerOptions.jit && !JitProgram::hostTarget(compilerOptions.target))
+    {
+        cerr << "--jit只支持x86和x86-64" << endl;
+        return 1;
+    }
+
+    // 只有一个源文件时输出写到标准输出；多个源文件时每个文件写到各自的.s或.o文件中
+    bool toStdout = sourceFileNames.size() == 1;
+    vector<int> results(sourceFileNames.size(), 0);
+    vector<JitProgram> programs(compilerOptions.jit ? sourceFileNames.size() : 0);
+    vector<BytecodeProgram> bytecodes(compilerOptions.vm ? sourceFileNames.size() : 0);
+    mutex diagnosticsMutex;
+
+    // 各个文件的上下文互不相干，文件之间、同一个文件的各个函数之间都在同一个线程池中并行
+    TaskPool pool(jobNum);
+    pool.parallelFor(sourceFileNames.size(), [&](size_t i)
+                     {
+        CompilationContext context(sourceFileNames[i]);
+        context.pool = &pool;
+        int result = compile(context);
+        if (compilerOptions.jit)
+        {
+            if (result == 0 && !programs[i].load(context.functions, context.diagnostics))
+                result = 1;
+        }
+        else if (compilerOptions.vm)
+        {
+            bytecodes[i] = std::move(context.bytecode);
+        }
+        else if (result == 0 && !writeOutput(context, toStdout))
+        {
+            context.diagnostics << "输出汇编代码失败" << endl;
+            result = 1;
+        }
+        results[i] = result;
+
+        string diagnostics = context.diagnostics.str();
+        if (!diagnostics.empty())
+        {
+            lock_guard<mutex> lock(diagnosticsMutex);
+            if (!toStdout)
+            {
+                cerr << context.sourceFileName << ":" << endl;
+            }
+            cerr << diagnostics;
+        } });
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        if (results[i] != 0)
+        {
+            return results[i];
+        }
+    }
+
+    // 全部编译完成后在主线程中按顺序运行，退出码是最后一个程序的main的返回值
+    if (compilerOptions.jit)
+    {
+        int exitCode = 0;
+        for (size_t i = 0; i < programs.size(); i++)
+        {
+            exitCode = programs[i].run();
+        }
+        return exitCode;
+    }
+    if (compilerOptions.vm)
+    {
+        int exitCode = 0;
+        for (size_t i = 0; i < bytecodes.size(); i++)
+        {
+            BytecodeVM vm(bytecodes[i]);
+            exitCode = vm.run();
+        }
+        return exitCode;
+    }
 
-    fclose(yyin);
     system("pause");
     return 0;
 }
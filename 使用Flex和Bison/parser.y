@@ -2,29 +2,47 @@
 #include <cstdio>
 
 #include "ASTNodes.h"
+#include "CompilationContext.h"
 #include "global.h"
 
-IdentifierTable Node::identifierTable; // 标识符表定义
-std::stack<int> Node::labelStack; // 标签栈，用于continue和break
-int Node::labelNo = 0;
+// 非终结符的位置取它的第一个符号的位置，空产生式取前一个符号的位置
+#define YYLLOC_DEFAULT(Current, Rhs, N) \
+	((Current) = (N) ? YYRHSLOC(Rhs, 1) : YYRHSLOC(Rhs, 0))
+%}
 
-std::shared_ptr<NBlock> programBlock;
-extern int yylex();
-extern int yylineno;
-void yyerror(const char* s)
+%code requires
 {
-    printf("Error: %s at line %d\n", s, yylineno);
+#include "SourceFile.h"
+
+class CompilationContext;
+}
+
+// 可重入的语法分析器：没有全局的yylval和yylloc，扫描器和编译上下文都作为参数传入
+%define api.pure full
+%parse-param {void *scanner} {CompilationContext &context}
+%lex-param {void *scanner}
+
+// 词法分析器为每个记号设置位置，记录它在源文件映射中的行号和偏移
+%define api.location.type {SourceLocation}
+%locations
+
+%code
+{
+extern int yylex(YYSTYPE *lvalp, YYLTYPE *llocp, void *scanner);
+
+void yyerror(YYLTYPE *llocp, void *scanner, CompilationContext &context, const char* s)
+{
+    context.diagnostics << "Error: " << s << " at line " << llocp->line << std::endl;
+}
 }
-%}
 
 %union
 {
 	int int_const;
-	std::string* str;
+	const Symbol* symbol;
 	int token;
 
-	NType* type;
-	NOperator* op;
+	CType type;
 	
 	NExpression* expression;
 	NStatement* statement;
@@ -35,10 +53,10 @@ void yyerror(const char* s)
 	
 	NBlock* block;
 
-	std::vector<std::shared_ptr<NExpression>>* expression_list;
+	ExpressionList* expression_list;
 }
 
-%token <str> T_IDENTIFIER
+%token <symbol> T_IDENTIFIER
 %token <int_const> T_INT_CONST
 %token <token> T_NEG T_NOT T_BITNOT
 %token <token> T_ASIGN
@@ -79,30 +97,30 @@ void yyerror(const char* s)
 %start c_program
 
 %%
-c_program : 	statements { programBlock = std::shared_ptr<NBlock>($1); }
+c_program : 	statements { context.program = $1; }
 				;
 
-statements : 	statement { $$ = new NBlock(); $$->statements->push_back(std::shared_ptr<NStatement>($<statement>1)); }
-				| statements statement { $1->statements->push_back(std::shared_ptr<NStatement>($<statement>2)); }
+statements : 	statement { $$ = context.arena.make<NBlock>(); $$->statements.push_back($1); }
+				| statements statement { $1->statements.push_back($2); }
 				;
 
 statement : 	var_decl T_SEMICOLON { $$ = $1; }
 				| func_define { $$ = $1; }
-				| expression T_SEMICOLON { $$ = new NExpressionStatement(std::shared_ptr<NExpression>($1)); }
-				| T_RETURN expression T_SEMICOLON { $$ = new NReturnStatement(std::shared_ptr<NExpression>($2)); }
-				| T_IF T_LPAREN expression T_RPAREN block { $$ = new NIfStatement(std::shared_ptr<NExpression>($3), std::shared_ptr<NBlock>($5)); }
-				| T_IF T_LPAREN expression T_RPAREN block T_ELSE block { $$ = new NIfStatement(std::shared_ptr<NExpression>($3), std::shared_ptr<NBlock>($5), std::shared_ptr<NBlock>($7)); }
-				| T_WHILE T_LPAREN expression T_RPAREN block { $$ = new NWhileStatement(std::shared_ptr<NExpression>($3), std::shared_ptr<NBlock>($5)); }
-				| T_CONTINUE T_SEMICOLON { $$ = new NContinueStatement(); }
-				| T_BREAK T_SEMICOLON { $$ = new NBreakStatement(); }
+				| expression T_SEMICOLON { $$ = context.arena.make<NExpressionStatement>($1); }
+				| T_RETURN expression T_SEMICOLON { $$ = context.arena.make<NReturnStatement>($2); }
+				| T_IF T_LPAREN expression T_RPAREN block { $$ = context.arena.make<NIfStatement>($3, $5); }
+				| T_IF T_LPAREN expression T_RPAREN block T_ELSE block { $$ = context.arena.make<NIfStatement>($3, $5, $7); }
+				| T_WHILE T_LPAREN expression T_RPAREN block { $$ = context.arena.make<NWhileStatement>($3, $5); }
+				| T_CONTINUE T_SEMICOLON { $$ = context.arena.make<NContinueStatement>(); }
+				| T_BREAK T_SEMICOLON { $$ = context.arena.make<NBreakStatement>(); }
 				;
 
 block : 		T_LBRACE statements T_RBRACE { $$ = $2; }
-				| T_LBRACE T_RBRACE { $$ = new NBlock(); }
+				| T_LBRACE T_RBRACE { $$ = context.arena.make<NBlock>(); }
 				;
 
-typename : 		T_INT { $$ = new NType(CType::INT); }
-				| T_VOID { $$ = new NType(CType::VOID); }
+typename : 		T_INT { $$ = CType::INT; }
+				| T_VOID { $$ = CType::VOID; }
 				;
 
 var_decl :		typename var_decl_inner { $$ = $2; }
@@ -110,80 +128,80 @@ var_decl :		typename var_decl_inner { $$ = $2; }
 
 var_decl_inner:	identifier
 					{
-						$$ = new NVariableDeclaration();
-						$$->addItem(std::shared_ptr<NIdentifier>($1));
+						$$ = context.arena.make<NVariableDeclaration>();
+						$$->addItem(context.arena.make<NVariableDeclarationInner>(CType::INT, $1));
 					}
 				| identifier T_ASIGN expression
 					{ 
-						$$ = new NVariableDeclaration();
-						$$->addItem(std::shared_ptr<NIdentifier>($1), nullptr, std::shared_ptr<NExpression>($3));
+						$$ = context.arena.make<NVariableDeclaration>();
+						$$->addItem(context.arena.make<NVariableDeclarationInner>(CType::INT, $1, $3));
 					}
 				| var_decl_inner T_COMMA identifier
 					{
-						$1->addItem(std::shared_ptr<NIdentifier>($3));
+						$1->addItem(context.arena.make<NVariableDeclarationInner>(CType::INT, $3));
 					}
 				| var_decl_inner T_COMMA identifier T_ASIGN expression
 					{
-						$1->addItem(std::shared_ptr<NIdentifier>($3), nullptr, std::shared_ptr<NExpression>($5));
+						$1->addItem(context.arena.make<NVariableDeclarationInner>(CType::INT, $3, $5));
 					}
 				;
 
 func_define : 	typename identifier T_LPAREN func_define_args T_RPAREN block 
-					{ $$ = new NFunctionDefine(std::shared_ptr<NType>($1), std::shared_ptr<NIdentifier>($2), std::shared_ptr<NVariableDeclaration>($4), std::shared_ptr<NBlock>($6)); }
+					{ $$ = context.arena.make<NFunctionDefine>($1, $2, $4, $6); }
 				;
 
-func_define_args : 	/* blank */ { $$ = new NVariableDeclaration(); }
+func_define_args : 	/* blank */ { $$ = context.arena.make<NVariableDeclaration>(); }
 					| typename identifier 
 						{ 	
-							$$ = new NVariableDeclaration();
-							$$->addItem(std::shared_ptr<NIdentifier>($2), std::shared_ptr<NType>($1));
+							$$ = context.arena.make<NVariableDeclaration>();
+							$$->addItem(context.arena.make<NVariableDeclarationInner>($1, $2));
 						}
 					| func_define_args T_COMMA typename identifier 
 						{ 
-							$$->addItem(std::shared_ptr<NIdentifier>($4), std::shared_ptr<NType>($3));
+							$$->addItem(context.arena.make<NVariableDeclarationInner>($3, $4));
 						}
 					;
 
-call_args : 	/* blank */ { $$ = new ExpressionList(); }
-				| expression { $$ = new ExpressionList(); $$->push_back(std::shared_ptr<NExpression>($1)); }
-				| call_args T_COMMA expression { $1->push_back(std::shared_ptr<NExpression>($3)); }
+call_args : 	/* blank */ { $$ = context.arena.make<ExpressionList>(); }
+				| expression { $$ = context.arena.make<ExpressionList>(); $$->push_back($1); }
+				| call_args T_COMMA expression { $1->push_back($3); }
 				;
 
-identifier : 	T_IDENTIFIER { $$ = new NIdentifier(*$1); delete $1; }
+identifier : 	T_IDENTIFIER { $$ = context.arena.make<NIdentifier>($1); $$->line = @1.line; $$->offset = @1.offset; }
 				;
 
-number : 		T_INT_CONST { $$ = new NInteger($1); }
+number : 		T_INT_CONST { $$ = context.arena.make<NInteger>($1); }
 				;
 
-expression : 	identifier T_ASIGN expression { $$ = new NAssignment(std::shared_ptr<NIdentifier>($1), std::shared_ptr<NExpression>($3)); }
-				| identifier T_LPAREN call_args T_RPAREN { $$ = new NMethodCall(std::shared_ptr<NIdentifier>($1), std::shared_ptr<ExpressionList>($3)); }
+expression : 	identifier T_ASIGN expression { $$ = context.arena.make<NAssignment>($1, $3); }
+				| identifier T_LPAREN call_args T_RPAREN { $$ = context.arena.make<NMethodCall>($1, $3); }
 				| identifier { $$ = $1; }
 				| number { $$ = $1; }
 				| T_LPAREN expression T_RPAREN { $$ = $2; }
 				| cal_expression { $$ = $1; }
 				;
 
-cal_expression:   T_NEG_OR_MINUS 			expression %prec T_NEG		{ auto op = new NOperator(COperator::NEG); 		$$ = new NUnaryOperatorExpression(std::shared_ptr<NExpression>($2), std::shared_ptr<NOperator>(op)); } 
-				| T_NOT 					expression 					{ auto op = new NOperator(COperator::NOT); 		$$ = new NUnaryOperatorExpression(std::shared_ptr<NExpression>($2), std::shared_ptr<NOperator>(op)); }
-				| T_BITNOT 					expression					{ auto op = new NOperator(COperator::BITNOT); 	$$ = new NUnaryOperatorExpression(std::shared_ptr<NExpression>($2), std::shared_ptr<NOperator>(op)); }
-			 	| expression T_CEQ 			expression 					{ auto op = new NOperator(COperator::CEQ);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_CNE 			expression 					{ auto op = new NOperator(COperator::CNE);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_CLT 			expression 					{ auto op = new NOperator(COperator::CLT);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_CLE 			expression 					{ auto op = new NOperator(COperator::CLE);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_CGT 			expression 					{ auto op = new NOperator(COperator::CGT);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_CGE			expression 					{ auto op = new NOperator(COperator::CGE);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_PLUS 		expression 					{ auto op = new NOperator(COperator::PLUS);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_NEG_OR_MINUS expression %prec T_MINUS	{ auto op = new NOperator(COperator::MINUS); 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_MUL 			expression 					{ auto op = new NOperator(COperator::MUL);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_DIV 			expression 					{ auto op = new NOperator(COperator::DIV);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_MOD			expression 					{ auto op = new NOperator(COperator::MOD);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_AND 			expression 					{ auto op = new NOperator(COperator::AND);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_OR			expression 					{ auto op = new NOperator(COperator::OR);	 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_BITAND 		expression 					{ auto op = new NOperator(COperator::BITAND);	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_BITOR 		expression 					{ auto op = new NOperator(COperator::BITOR); 	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_BITXOR 		expression 					{ auto op = new NOperator(COperator::BITXOR);	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_RSHIFT 		expression 					{ auto op = new NOperator(COperator::RSHIFT);	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
-				| expression T_LSHIFT		expression 					{ auto op = new NOperator(COperator::LSHIFT);	$$ = new NBinaryOperatorExpression(std::shared_ptr<NExpression>($1), std::shared_ptr<NOperator>(op), std::shared_ptr<NExpression>($3)); }
+cal_expression:   T_NEG_OR_MINUS 			expression %prec T_NEG		{ $$ = context.arena.make<NUnaryOperatorExpression>($2, COperator::NEG); } 
+				| T_NOT 					expression 					{ $$ = context.arena.make<NUnaryOperatorExpression>($2, COperator::NOT); }
+				| T_BITNOT 					expression					{ $$ = context.arena.make<NUnaryOperatorExpression>($2, COperator::BITNOT); }
+			 	| expression T_CEQ 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::CEQ, $3); }
+				| expression T_CNE 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::CNE, $3); }
+				| expression T_CLT 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::CLT, $3); }
+				| expression T_CLE 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::CLE, $3); }
+				| expression T_CGT 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::CGT, $3); }
+				| expression T_CGE			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::CGE, $3); }
+				| expression T_PLUS 		expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::PLUS, $3); }
+				| expression T_NEG_OR_MINUS expression %prec T_MINUS	{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::MINUS, $3); }
+				| expression T_MUL 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::MUL, $3); }
+				| expression T_DIV 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::DIV, $3); }
+				| expression T_MOD			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::MOD, $3); }
+				| expression T_AND 			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::AND, $3); }
+				| expression T_OR			expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::OR, $3); }
+				| expression T_BITAND 		expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::BITAND, $3); }
+				| expression T_BITOR 		expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::BITOR, $3); }
+				| expression T_BITXOR 		expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::BITXOR, $3); }
+				| expression T_RSHIFT 		expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::RSHIFT, $3); }
+				| expression T_LSHIFT		expression 					{ $$ = context.arena.make<NBinaryOperatorExpression>($1, COperator::LSHIFT, $3); }
 				;
 
 %%
\ No newline at end of file
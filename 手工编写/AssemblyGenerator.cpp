@@ -1,3 +1,5 @@
+#include <climits>
+
 #include "AssemblyGenerator.h"
 
 void AssemblyGenerator::writeLine(const std::string& line, int tabNum) {
@@ -118,30 +120,37 @@ std::vector<Token> AssemblyGenerator::getPostfixExpression(size_t start, size_t
     return res;
 }
 
-int AssemblyGenerator::constBinaryCalculate(Token& left, Token& right, Token& op) {
-    int res;
+bool AssemblyGenerator::constBinaryCalculate(Token& left, Token& right, Token& op, int& res) {
     int leftNum = left.code;
-    int rightNum = left.code;
+    int rightNum = right.code;
     switch (op.kind) {
     case wordType::OPERATOR3_div:
+        if (rightNum == 0 || (leftNum == INT_MIN && rightNum == -1))
+            return false;
         res = leftNum / rightNum;
         break;
     case wordType::OPERATOR3_mul:
-        res = leftNum * rightNum;
+        res = (int)((unsigned)leftNum * (unsigned)rightNum);
         break;
     case wordType::OPERATOR3_mod:
+        if (rightNum == 0 || (leftNum == INT_MIN && rightNum == -1))
+            return false;
         res = leftNum % rightNum;
         break;
     case wordType::OPERATOR4_add:
-        res = leftNum + rightNum;
+        res = (int)((unsigned)leftNum + (unsigned)rightNum);
         break;
     case wordType::OPERATOR4_sub:
-        res = leftNum - rightNum;
+        res = (int)((unsigned)leftNum - (unsigned)rightNum);
         break;
     case wordType::OPERATOR5_left_shift:
-        res = leftNum << rightNum;
+        if (rightNum < 0 || rightNum > 31)
+            return false;
+        res = (int)((unsigned)leftNum << rightNum);
         break;
     case wordType::OPERATOR5_right_shift:
+        if (rightNum < 0 || rightNum > 31)
+            return false;
         res = leftNum >> rightNum;
         break;
     case wordType::OPERATOR6_less:
@@ -171,8 +180,10 @@ int AssemblyGenerator::constBinaryCalculate(Token& left, Token& right, Token& op
     case wordType::OPERATOR10_logical_or:
         res = leftNum | rightNum;
         break;
+    default:
+        return false;
     }
-    return res;
+    return true;
 }
 
 void AssemblyGenerator::varBinaryCalculate(Token& op) {
@@ -205,11 +216,15 @@ void AssemblyGenerator::varBinaryCalculate(Token& op) {
         writeLine(line, 1);
         break;
     case wordType::OPERATOR5_left_shift:
-        line = "shl eax, ebx";
+        line = "mov ecx, ebx";
+        writeLine(line, 1);
+        line = "sal eax, cl";
         writeLine(line, 1);
         break;
     case wordType::OPERATOR5_right_shift:
-        line = "shr eax, ebx";
+        line = "mov ecx, ebx";
+        writeLine(line, 1);
+        line = "sar eax, cl";
         writeLine(line, 1);
         break;
     case wordType::OPERATOR6_less:
@@ -276,31 +291,24 @@ void AssemblyGenerator::varBinaryCalculate(Token& op) {
 }
 
 void AssemblyGenerator::binaryCalculate(Token& left, Token& right, Token& op) {
-    if (left.kind == wordType::CONST_INT && right.kind == wordType::CONST_INT) // ߶ǳ
+    int res;
+    if (left.kind == wordType::CONST_INT && right.kind == wordType::CONST_INT && constBinaryCalculate(left, right, op, res)) // ߶ǳ
     {
-        std::string line = "mov eax, " + std::to_string(constBinaryCalculate(left, right, op));
+        std::string line = "mov eax, " + std::to_string(res);
         this->writeLine(line, 1);
     }
-    else { // һΪʶ
-        if (left.kind == wordType::IDENTIFIER && right.kind == wordType::IDENTIFIER)
-        {
-            std::string line = "mov eax, DWORD PTR [ebp-" + std::to_string(getEbpOffset(left)) + "]";
-            this->writeLine(line, 1);
-            line = "mov ebx, DWORD PTR [ebp-" + std::to_string(getEbpOffset(right)) + "]";
-            this->writeLine(line, 1);
-        }
-        else if (left.kind == wordType::CONST_INT) {
-            std::string line = "mov eax, " + std::to_string(left.code);
-            this->writeLine(line, 1);
-            line = "mov ebx, DWORD PTR [ebp-" + std::to_string(getEbpOffset(right)) + "]";
-            this->writeLine(line, 1);
-        }
-        else {
-            std::string line = "mov eax, DWORD PTR [ebp-" + std::to_string(getEbpOffset(left)) + "]";
-            this->writeLine(line, 1);
+    else { // һΪʶ߳ĽҪʱȷ
+        std::string line;
+        if (left.kind == wordType::CONST_INT)
+            line = "mov eax, " + std::to_string(left.code);
+        else
+            line = "mov eax, DWORD PTR [ebp-" + std::to_string(getEbpOffset(left)) + "]";
+        this->writeLine(line, 1);
+        if (right.kind == wordType::CONST_INT)
             line = "mov ebx, " + std::to_string(right.code);
-            this->writeLine(line, 1);
-        }
+        else
+            line = "mov ebx, DWORD PTR [ebp-" + std::to_string(getEbpOffset(right)) + "]";
+        this->writeLine(line, 1);
         varBinaryCalculate(op);
     }
 }
\ No newline at end of file
@@ -11,13 +11,23 @@ private:
     Table<std::string> identifierTable;
     std::string assemblyCode;
     int varNum; // ֲĿ
+    int maxVarNum; // ջ֡õĵԪĿֲʱ
+    size_t frameLinePos; // Ԥջָ֡ڻеĲλ
 
 public:
     AssemblyGenerator(std::vector<Token> &tokens, Table<std::string>& identifierTable) : tokens(tokens), identifierTable(identifierTable) {
         this->varNum = identifierTable.size();
+        this->maxVarNum = this->varNum;
+        this->frameLinePos = 0;
         this->genAssemblyFrame();
     }
 
+    // ջ֡ʵԤֽ
+    // 뺯ʱesp+416ֽڶ룬push ebp֮󻹲8ֽڣprintln_intѹջ8ֽڣԤ16ıʹcallʱ
+    int getFrameSize() {
+        return (maxVarNum * 4 + 15) / 16 * 16;
+    }
+
     std::string generate() {
         parseFuncDefineStatement(0, tokens.size());
         return assemblyCode;
@@ -68,8 +78,8 @@ private:
         writeLine(line, 1);
         line = "mov ebp, esp";
         writeLine(line, 1);
-        line = "sub esp, 0x100";
-        writeLine(line, 1);
+        // ʱĿҪ꺯֪֮ٲԤջָ֡
+        frameLinePos = assemblyCode.size();
         while (tokens[start++].kind != wordType::BRACE_LEFT) {
             len--;
         }
@@ -104,6 +114,9 @@ private:
                 i += len;
             }
         }
+        if (getFrameSize() != 0) {
+            assemblyCode.insert(frameLinePos, "\tsub esp, " + std::to_string(getFrameSize()) + "\n");
+        }
     }
 
     // 
@@ -127,6 +140,9 @@ private:
         token.kind = wordType::IDENTIFIER;
         token.code = this->varNum;
         this->varNum += 1;
+        if (this->varNum > this->maxVarNum) {
+            this->maxVarNum = this->varNum;
+        }
         std::string line = "mov DWORD PTR [ebp-" + std::to_string(getEbpOffset(token)) + "], eax";
         writeLine(line, 1);
         return token;
@@ -172,7 +188,8 @@ private:
     }
 
     // ߶ǳ˫Ŀֱ̣Ӽ
-    int constBinaryCalculate(Token& left, Token& right, Token& op);
+    // 㡢λԽʱȷΪ㣬false
+    bool constBinaryCalculate(Token& left, Token& right, Token& op, int& res);
 
     // 洢eaxҲ洢ebx洢eax
     void varBinaryCalculate(Token& op);
@@ -0,0 +1,185 @@
+// ʷ΢׼ԣһκϳɵԴ򣬷ֱDFAʷԭstd::regexʵɨ裬
+// Ƚߵõһ
+// ÷LexerBenchmark [ԴС(KB)Ĭ1024] [--no-baseline]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "global.h"
+#include "LexicalAnalyzer.h"
+
+using namespace std;
+
+namespace {
+
+// ԭʵ֣ÿйһwordRegexÿγԸ͵ʽ
+class RegexLexer {
+public:
+    Table<string> identifierTable;
+    vector<Token> tokens;
+
+    void lexicalAnalysis(const string& line) {
+        regex wordRegex("([a-zA-Z_]\\w*)|\\d+|(<=)|(>=)|(==)|(!=)|(>>)|(<<)|[-=+*/%();{}!&|^<>]");
+        for (sregex_iterator i(line.begin(), line.end(), wordRegex), end; i != end; i++) {
+            string word = i->str();
+            for (auto it = wordTypeRegexMap.begin(); it != wordTypeRegexMap.end(); ++it) {
+                if (regex_match(word, it->second)) {
+                    Token token;
+                    token.kind = it->first;
+                    if (it->first == wordType::IDENTIFIER) {
+                        token.code = identifierTable.add(word);
+                    }
+                    else if (it->first == wordType::CONST_INT) {
+                        token.code = stoi(word);
+                    }
+                    else {
+                        token.code = precedence(it->first);
+                    }
+                    tokens.push_back(token);
+                    break;
+                }
+            }
+        }
+    }
+
+private:
+    static int precedence(wordType kind) {
+        static const map<wordType, int> table = {
+            {wordType::OPERATOR1_left_parentheses, 1}, {wordType::OPERATOR1_right_parentheses, 1},
+            {wordType::OPERATOR3_div, 3}, {wordType::OPERATOR3_mul, 3}, {wordType::OPERATOR3_mod, 3},
+            {wordType::OPERATOR4_add, 4}, {wordType::OPERATOR4_sub, 4},
+            {wordType::OPERATOR5_left_shift, 5}, {wordType::OPERATOR5_right_shift, 5},
+            {wordType::OPERATOR6_less, 6}, {wordType::OPERATOR6_less_equal, 6},
+            {wordType::OPERATOR6_greater, 6}, {wordType::OPERATOR6_greater_equal, 6},
+            {wordType::OPERATOR7_equal, 7}, {wordType::OPERATOR7_not_equal, 7},
+            {wordType::OPERATOR8_logical_and, 8}, {wordType::OPERATOR9_logical_xor, 9},
+            {wordType::OPERATOR10_logical_or, 10}, {wordType::OPERATOR14_assignment, 14},
+        };
+        auto it = table.find(kind);
+        return it == table.end() ? 0 : it->second;
+    }
+
+    const map<wordType, regex> wordTypeRegexMap = {
+        {wordType::KEYWORD_int, regex("int")},
+        {wordType::KEYWORD_return, regex("return")},
+        {wordType::IDENTIFIER_main, regex("main")},
+        {wordType::IDENTIFIER_println_int, regex("println_int")},
+        {wordType::IDENTIFIER, regex("[a-zA-Z_][a-zA-Z0-9_]*")},
+        {wordType::CONST_INT, regex("\\d+")},
+        {wordType::OPERATOR1_left_parentheses, regex("\\(")},
+        {wordType::OPERATOR1_right_parentheses, regex("\\)")},
+        {wordType::OPERATOR3_div, regex("/")},
+        {wordType::OPERATOR3_mul, regex("\\*")},
+        {wordType::OPERATOR3_mod, regex("%")},
+        {wordType::OPERATOR4_add, regex("\\+")},
+        {wordType::OPERATOR4_sub, regex("\\-")},
+        {wordType::OPERATOR5_left_shift, regex("<<")},
+        {wordType::OPERATOR5_right_shift, regex(">>")},
+        {wordType::OPERATOR6_less, regex("<")},
+        {wordType::OPERATOR6_less_equal, regex("<=")},
+        {wordType::OPERATOR6_greater, regex(">")},
+        {wordType::OPERATOR6_greater_equal, regex(">=")},
+        {wordType::OPERATOR7_equal, regex("==")},
+        {wordType::OPERATOR7_not_equal, regex("!=")},
+        {wordType::OPERATOR8_logical_and, regex("&")},
+        {wordType::OPERATOR9_logical_xor, regex("\\^")},
+        {wordType::OPERATOR10_logical_or, regex("\\|")},
+        {wordType::OPERATOR14_assignment, regex("=")},
+        {wordType::SEPARATOR, regex(";")},
+        {wordType::BRACE_LEFT, regex("\\{")},
+        {wordType::BRACE_RIGHT, regex("\\}")},
+    };
+};
+
+// ɴԼsizeֽڡе͵Դ
+string generateSource(size_t size) {
+    static const char* ops[] = {"+", "-", "*", "/", "%", "<<", ">>", "<", "<=", ">", ">=", "==", "!=", "&", "^", "|"};
+    string source = "int main() {\n";
+    unsigned seed = 1;
+    int line = 0;
+    while (source.size() < size) {
+        seed = seed * 1103515245u + 12345u;
+        int a = line % 997, b = (seed >> 8) % 997;
+        source += "    int v" + to_string(line) + ";\n";
+        source += "    v" + to_string(line) + " = (v" + to_string(a) + " " + ops[(seed >> 4) % 16] + " " +
+                  to_string(seed % 100000) + ") " + ops[(seed >> 12) % 16] + " v" + to_string(b) + ";\n";
+        if (line % 16 == 0) {
+            source += "    println_int(v" + to_string(line) + ");\n";
+        }
+        line++;
+    }
+    source += "    return 0;\n}\n";
+    return source;
+}
+
+double seconds(chrono::steady_clock::time_point begin) {
+    return chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    size_t sizeKB = 1024;
+    bool baseline = true;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--no-baseline") {
+            baseline = false;
+        }
+        else {
+            sizeKB = strtoul(argv[i], nullptr, 10);
+        }
+    }
+
+    string source = generateSource(sizeKB * 1024);
+    double megabytes = source.size() / (1024.0 * 1024.0);
+    cout << "source: " << source.size() << " bytes" << endl;
+
+    // ȡһ
+    LexicalAnalyzer dfaLexer;
+    double dfaTime = 0;
+    for (int round = 0; round < 5; round++) {
+        LexicalAnalyzer lexer;
+        auto begin = chrono::steady_clock::now();
+        lexer.lexicalAnalysis(source.data(), source.size());
+        double t = seconds(begin);
+        if (round == 0 || t < dfaTime) {
+            dfaTime = t;
+        }
+        if (round == 0) {
+            dfaLexer = lexer;
+        }
+    }
+    cout << "dfa:   " << dfaLexer.tokens.size() << " tokens, " << dfaTime * 1000 << " ms, " << megabytes / dfaTime << " MB/s" << endl;
+
+    if (!baseline) {
+        return 0;
+    }
+
+    RegexLexer regexLexer;
+    istringstream input(source);
+    string line;
+    auto begin = chrono::steady_clock::now();
+    while (getline(input, line)) {
+        regexLexer.lexicalAnalysis(line);
+    }
+    double regexTime = seconds(begin);
+    cout << "regex: " << regexLexer.tokens.size() << " tokens, " << regexTime * 1000 << " ms, " << megabytes / regexTime << " MB/s" << endl;
+    cout << "speedup: " << regexTime / dfaTime << "x" << endl;
+
+    bool same = dfaLexer.tokens.size() == regexLexer.tokens.size();
+    for (size_t i = 0; same && i < dfaLexer.tokens.size(); i++) {
+        same = dfaLexer.tokens[i].kind == regexLexer.tokens[i].kind && dfaLexer.tokens[i].code == regexLexer.tokens[i].code;
+    }
+    if (!same) {
+        cerr << "token streams differ" << endl;
+        return 1;
+    }
+    return 0;
+}
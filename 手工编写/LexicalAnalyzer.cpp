@@ -1,66 +1,222 @@
 #include "LexicalAnalyzer.h"
 
+#include <cstring>
+
+namespace {
+
+// ַDFAǰַת
+enum CharClass {
+    C_OTHER,    // հ׺޷ʶַ
+    C_LETTER,   // a-z A-Z _
+    C_DIGIT,    // 0-9
+    C_LT, C_GT, C_EQ, C_BANG,
+    C_LPAREN, C_RPAREN, C_DIV, C_MUL, C_MOD, C_ADD, C_SUB,
+    C_AND, C_XOR, C_OR, C_SEMI, C_LBRACE, C_RBRACE,
+    CLASS_NUM
+};
+
+// DFA״̬S_DEADʾûת
+enum State {
+    S_DEAD, S_START,
+    S_IDENT, S_NUMBER,
+    S_LT, S_LE, S_SHL, S_GT, S_GE, S_SHR, S_ASSIGN, S_EQ, S_BANG, S_NE,
+    S_LPAREN, S_RPAREN, S_DIV, S_MUL, S_MOD, S_ADD, S_SUB,
+    S_AND, S_XOR, S_OR, S_SEMI, S_LBRACE, S_RBRACE,
+    STATE_NUM
+};
+
+// תƱͽܱһʹʱ
+struct Dfa {
+    unsigned char charClass[256];
+    unsigned char next[STATE_NUM][CLASS_NUM];
+    signed char accept[STATE_NUM]; // ״̬Ӧĵͣǽ״̬Ϊ-1
+
+    Dfa() {
+        std::memset(charClass, C_OTHER, sizeof(charClass));
+        std::memset(next, S_DEAD, sizeof(next));
+        std::memset(accept, -1, sizeof(accept));
+
+        for (int c = 'a'; c <= 'z'; c++) charClass[c] = C_LETTER;
+        for (int c = 'A'; c <= 'Z'; c++) charClass[c] = C_LETTER;
+        charClass['_'] = C_LETTER;
+        for (int c = '0'; c <= '9'; c++) charClass[c] = C_DIGIT;
+
+        next[S_START][C_LETTER] = S_IDENT;
+        next[S_IDENT][C_LETTER] = S_IDENT;
+        next[S_IDENT][C_DIGIT] = S_IDENT;
+        accept[S_IDENT] = wordType::IDENTIFIER;
+
+        next[S_START][C_DIGIT] = S_NUMBER;
+        next[S_NUMBER][C_DIGIT] = S_NUMBER;
+        accept[S_NUMBER] = wordType::CONST_INT;
+
+        // ˫ַǰ׺ַ
+        single('<', C_LT, S_LT, wordType::OPERATOR6_less);
+        single('>', C_GT, S_GT, wordType::OPERATOR6_greater);
+        single('=', C_EQ, S_ASSIGN, wordType::OPERATOR14_assignment);
+        charClass['!'] = C_BANG;
+        next[S_START][C_BANG] = S_BANG;
+        pair(S_LT, C_EQ, S_LE, wordType::OPERATOR6_less_equal);
+        pair(S_LT, C_LT, S_SHL, wordType::OPERATOR5_left_shift);
+        pair(S_GT, C_EQ, S_GE, wordType::OPERATOR6_greater_equal);
+        pair(S_GT, C_GT, S_SHR, wordType::OPERATOR5_right_shift);
+        pair(S_ASSIGN, C_EQ, S_EQ, wordType::OPERATOR7_equal);
+        pair(S_BANG, C_EQ, S_NE, wordType::OPERATOR7_not_equal);
+
+        single('(', C_LPAREN, S_LPAREN, wordType::OPERATOR1_left_parentheses);
+        single(')', C_RPAREN, S_RPAREN, wordType::OPERATOR1_right_parentheses);
+        single('/', C_DIV, S_DIV, wordType::OPERATOR3_div);
+        single('*', C_MUL, S_MUL, wordType::OPERATOR3_mul);
+        single('%', C_MOD, S_MOD, wordType::OPERATOR3_mod);
+        single('+', C_ADD, S_ADD, wordType::OPERATOR4_add);
+        single('-', C_SUB, S_SUB, wordType::OPERATOR4_sub);
+        single('&', C_AND, S_AND, wordType::OPERATOR8_logical_and);
+        single('^', C_XOR, S_XOR, wordType::OPERATOR9_logical_xor);
+        single('|', C_OR, S_OR, wordType::OPERATOR10_logical_or);
+        single(';', C_SEMI, S_SEMI, wordType::SEPARATOR);
+        single('{', C_LBRACE, S_LBRACE, wordType::BRACE_LEFT);
+        single('}', C_RBRACE, S_RBRACE, wordType::BRACE_RIGHT);
+    }
+
+    void single(unsigned char c, CharClass cls, State state, wordType kind) {
+        charClass[c] = cls;
+        next[S_START][cls] = state;
+        accept[state] = kind;
+    }
+
+    void pair(State from, CharClass cls, State state, wordType kind) {
+        next[from][cls] = state;
+        accept[state] = kind;
+    }
+};
+
+const Dfa dfa;
+
+// ؼֺʶϣ( + ַ) & 7 ĸϻͻ
+struct Keyword {
+    const char* text;
+    size_t length;
+    wordType kind;
+};
+
+const Keyword keywords[8] = {
+    {"return", 6, wordType::KEYWORD_return},            // (6 + 'r') & 7 = 0
+    {"main", 4, wordType::IDENTIFIER_main},             // (4 + 'm') & 7 = 1
+    {nullptr, 0, wordType::IDENTIFIER},
+    {"println_int", 11, wordType::IDENTIFIER_println_int}, // (11 + 'p') & 7 = 3
+    {"int", 3, wordType::KEYWORD_int},                  // (3 + 'i') & 7 = 4
+    {nullptr, 0, wordType::IDENTIFIER},
+    {nullptr, 0, wordType::IDENTIFIER},
+    {nullptr, 0, wordType::IDENTIFIER},
+};
+
+wordType classifyIdentifier(const char* word, size_t length) {
+    const Keyword& keyword = keywords[(length + (unsigned char)word[0]) & 7];
+    if (keyword.length == length && std::memcmp(keyword.text, word, length) == 0) {
+        return keyword.kind;
+    }
+    return wordType::IDENTIFIER;
+}
+
+// ֵȼ൥Ϊ0
+int operatorPrecedence(wordType kind) {
+    switch (kind) {
+    case wordType::OPERATOR1_left_parentheses: case wordType::OPERATOR1_right_parentheses:
+        return 1;
+    case wordType::OPERATOR3_div: case wordType::OPERATOR3_mul: case wordType::OPERATOR3_mod:
+        return 3;
+    case wordType::OPERATOR4_add: case wordType::OPERATOR4_sub:
+        return 4;
+    case wordType::OPERATOR5_left_shift: case wordType::OPERATOR5_right_shift:
+        return 5;
+    case wordType::OPERATOR6_less: case wordType::OPERATOR6_less_equal: case wordType::OPERATOR6_greater: case wordType::OPERATOR6_greater_equal:
+        return 6;
+    case wordType::OPERATOR7_equal: case wordType::OPERATOR7_not_equal:
+        return 7;
+    case wordType::OPERATOR8_logical_and:
+        return 8;
+    case wordType::OPERATOR9_logical_xor:
+        return 9;
+    case wordType::OPERATOR10_logical_or:
+        return 10;
+    case wordType::OPERATOR14_assignment:
+        return 14;
+    default:
+        return 0;
+    }
+}
+
+}
 
 std::vector<Token> LexicalAnalyzer::lexicalAnalysis(const std::string& line)
 {
-    std::regex wordRegex("([a-zA-Z_]\\w*)|\\d+|(<=)|(>=)|(==)|(!=)|(>>)|(<<)|[-=+*/%();{}!&|^<>]");
-    std::sregex_iterator wordsBegin = std::sregex_iterator(line.begin(), line.end(), wordRegex);
-    std::sregex_iterator wordsEnd = std::sregex_iterator();
+    size_t count = lexicalAnalysis(line.data(), line.size());
+    return std::vector<Token>(tokens.end() - count, tokens.end());
+}
 
-    std::vector<Token> lineTokens;
-    for (std::sregex_iterator i = wordsBegin; i != wordsEnd; i++)
-    {
-        std::smatch match = *i;
-        std::string word = match.str();
-        Token token;
-        for (auto it = wordTypeRegexMap.begin(); it != wordTypeRegexMap.end(); ++it) {
-            if (regex_match(word, it->second)) {
-                token.kind = it->first;
-                switch (it->first) {
-                case wordType::IDENTIFIER:
-                    token.code = identifierTable.add(word);
-                    break;
-                case wordType::CONST_INT:
-                    token.code = stoi(word);
-                    break;
-                case wordType::OPERATOR1_left_parentheses: case wordType::OPERATOR1_right_parentheses:
-                    token.code = 1;
-                    break;
-                case wordType::OPERATOR3_div: case wordType::OPERATOR3_mul: case wordType::OPERATOR3_mod:
-                    token.code = 3;
-                    break;
-                case wordType::OPERATOR4_add: case wordType::OPERATOR4_sub:
-                    token.code = 4;
-                    break;
-                case wordType::OPERATOR5_left_shift: case wordType::OPERATOR5_right_shift:
-                    token.code = 5;
-                    break;
-                case wordType::OPERATOR6_less: case wordType::OPERATOR6_less_equal: case wordType::OPERATOR6_greater: case wordType::OPERATOR6_greater_equal:
-                    token.code = 6;
-                    break;
-                case wordType::OPERATOR7_equal: case wordType::OPERATOR7_not_equal:
-                    token.code = 7;
-                    break;
-                case wordType::OPERATOR8_logical_and:
-                    token.code = 8;
-                    break;
-                case wordType::OPERATOR9_logical_xor:
-                    token.code = 9;
-                    break;
-                case wordType::OPERATOR10_logical_or:
-                    token.code = 10;
-                    break;
-                case wordType::OPERATOR14_assignment:
-                    token.code = 14;
-                    break;
-                default:
-                    token.code = 0;
-                }
+size_t LexicalAnalyzer::lexicalAnalysis(const char* text, size_t length)
+{
+    size_t oldSize = tokens.size();
+    size_t i = 0;
+    while (i < length) {
+        // ƥ䣺һֱתƵûг·Ϊֹȡ󾭹Ľ״̬
+        size_t start = i;
+        int state = S_START;
+        int acceptState = S_DEAD;
+        size_t acceptEnd = i;
+        while (i < length) {
+            int nextState = dfa.next[state][dfa.charClass[(unsigned char)text[i]]];
+            if (nextState == S_DEAD) {
                 break;
             }
+            state = nextState;
+            i++;
+            if (dfa.accept[state] >= 0) {
+                acceptState = state;
+                acceptEnd = i;
+            }
+        }
+        if (acceptState == S_DEAD) {
+            // հ׺޷ʶַ!ֱ
+            i = start + 1;
+            continue;
         }
-        lineTokens.push_back(token);
+        i = acceptEnd;
+        tokens.push_back(makeToken(acceptState, text, start, acceptEnd - start));
+    }
+    return tokens.size() - oldSize;
+}
+
+Token LexicalAnalyzer::makeToken(int state, const char* text, size_t offset, size_t length)
+{
+    const char* word = text + offset;
+    Token token;
+    token.kind = (wordType)dfa.accept[state];
+    token.offset = (unsigned)offset;
+    token.length = (unsigned)length;
+    switch (token.kind) {
+    case wordType::IDENTIFIER:
+        token.kind = classifyIdentifier(word, length);
+        if (token.kind == wordType::IDENTIFIER) {
+            std::string name(word, length);
+            token.code = identifierTable.add(name);
+        }
+        else {
+            token.code = 0;
+        }
+        break;
+    case wordType::CONST_INT:
+    {
+        unsigned value = 0;
+        for (size_t i = 0; i < length; i++) {
+            value = value * 10 + (word[i] - '0');
+        }
+        token.code = (int)value;
+        break;
+    }
+    default:
+        token.code = operatorPrecedence(token.kind);
+        break;
     }
-    tokens.insert(tokens.end(), lineTokens.begin(), lineTokens.end());
-    return lineTokens;
-}
\ No newline at end of file
+    return token;
+}
@@ -0,0 +1,53 @@
+#include "SourceFile.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+SourceFile::~SourceFile()
+{
+    close();
+}
+
+bool SourceFile::open(const std::string& fileName)
+{
+    close();
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        return false;
+    }
+
+    // ȱһȫӳ䣬ٰļӳ䵽Ŀͷ
+    // ļǡҳСʱĩβ'\0'ӳϣǲԽļһҳ
+    size_t length = info.st_size;
+    void* base = mmap(nullptr, length + PADDING, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        ::close(fd);
+        return false;
+    }
+    if (length > 0 && mmap(base, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, length + PADDING);
+        ::close(fd);
+        return false;
+    }
+    ::close(fd);
+
+    buffer = static_cast<char*>(base);
+    bufferSize = length;
+    return true;
+}
+
+void SourceFile::close()
+{
+    if (buffer != nullptr) {
+        munmap(buffer, bufferSize + PADDING);
+        buffer = nullptr;
+        bufferSize = 0;
+    }
+}
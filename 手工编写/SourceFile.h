@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// ڴӳ䷽ʽ򿪵Դļʷֱɨӳ䣬ж
+// ӳ˽ӳ(MAP_PRIVATE)ĸĶдļļ֮'\0'
+class SourceFile
+{
+public:
+    static const size_t PADDING = 2; // ĩβ'\0'ĸ
+
+	SourceFile() {}
+    SourceFile(const SourceFile&) = delete;
+    SourceFile& operator=(const SourceFile&) = delete;
+    ~SourceFile();
+
+    // ӳļfileNameɹʱtrue
+    bool open(const std::string& fileName);
+    void close();
+
+    // ļݵʼַеƫƶ
+    char* data() const { return buffer; }
+
+    // ļȣĩβ'\0'
+    size_t size() const { return bufferSize; }
+
+private:
+    char* buffer = nullptr;
+    size_t bufferSize = 0;
+};
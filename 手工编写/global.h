@@ -1,7 +1,7 @@
 #pragma once
 #include <vector>
-#include <algorithm>
 #include <string>
+#include <unordered_map>
 
 // 
 enum wordType {
@@ -39,32 +39,49 @@ enum wordType {
 struct Token {
     wordType kind;
     int code;
+    unsigned offset = 0; // ԴıеƫƣԴıļӳʱӳƫ
+    unsigned length = 0; // ʵĳȣҪԭʱֱӻصԴıȡַ
 };
 
 template<typename T>
 class Table {
 public:
+    static const size_t npos = (size_t)-1;
+
     // tableԪأԪѾڣֱӷ±
-    size_t add(T& item) {
-        size_t index;
-        auto it = std::find(table.begin(), table.end(), item);
-        if (it == table.end()) {
-            index = table.size();
-            table.push_back(item);
+    // ±갴һӵ˳0ʼţ֮󲻻ı
+    size_t add(const T& item) {
+        auto it = positions.find(item);
+        if (it != positions.end()) {
+            return it->second;
         }
-        else {
-            index = std::distance(table.begin(), it);
+        size_t position = table.size();
+        table.push_back(item);
+        positions.emplace(item, position);
+        return position;
+    }
+
+    // Ԫص±꣬ʱnposԪ
+    size_t find(const T& item) const {
+        auto it = positions.find(item);
+        if (it == positions.end()) {
+            return npos;
         }
-        return index;
+        return it->second;
     }
 
-    T get(size_t index) {
+    const T& get(size_t index) const {
         return table.at(index);
     }
 
-    size_t size() {
+    const T& operator[](size_t index) const {
+        return table[index];
+    }
+
+    size_t size() const {
         return table.size();
     }
 private:
     std::vector<T> table;
+    std::unordered_map<T, size_t> positions; // Ԫص±
 };
@@ -1,31 +1,37 @@
 #include <iostream>
-#include <fstream>
 #include <string>
 #include <stack>
 
 #include "global.h"
 #include "LexicalAnalyzer.h"
 #include "AssemblyGenerator.h"
+#include "SourceFile.h"
 
 using namespace std;
 
 int main(int argc, char* argv[])
 {
-    string sourceFileName = argv[1];
+    string sourceFileName;
+    bool printStats = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--stats") {
+            printStats = true;
+        }
+        else {
+            sourceFileName = arg;
+        }
+    }
     // string sourceFileName = "./input.txt";
-    ifstream sourceFile(sourceFileName, ifstream::in);
-    if (!sourceFile.is_open()) {
+    SourceFile sourceFile;
+    if (!sourceFile.open(sourceFileName)) {
         cerr << "Դ�ļ��޷���" << endl;
         return 1;
     }
     
     LexicalAnalyzer la;
-    // ��ȡ�ļ�����
-    string line;
-    while (getline(sourceFile, line)) {
-        la.lexicalAnalysis(line);
-    }
-    sourceFile.close();
+    // 整个源文件映射到内存中，一次扫描完，不再逐行复制
+    la.lexicalAnalysis(sourceFile.data(), sourceFile.size());
 
     //for (auto a : la.tokens) {
     //    cout << a.kind << "*" << a.code << endl;
@@ -33,6 +39,9 @@ int main(int argc, char* argv[])
 
     AssemblyGenerator ag(la.tokens, la.identifierTable);
     cout << ag.generate() << endl;
+    if (printStats) {
+        cerr << "[frame] main: " << ag.getFrameSize() << " bytes" << endl;
+    }
 
     system("pause");
     return 0;